@@ -1,46 +1,269 @@
 #include "allocator.h"
+#include "allocator_internal.h"
+#include <string.h>
+
+#ifdef SEARCH_COUNTERS
+#define COUNT_EVENT(allocator, counter) ((allocator)->search.counter++)
+#else
+#define COUNT_EVENT(allocator, counter) ((void)0)
+#endif
+
+#ifdef HEAP_PROFILE
+#if defined(__GNUC__)
+#define CALLSITE() __builtin_return_address(0)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define CALLSITE() _ReturnAddress()
+#else
+#error "HEAP_PROFILE needs a compiler that can report return addresses"
+#endif
+// Only allocations that reach the next sample point leave the inline countdown
+#define PROFILE_ALLOCATION(allocator, index, size) do { \
+    if ((allocator)->profile.interval != 0 && ((allocator)->profile.countdown -= (size)) <= 0) { \
+        profileAllocation((allocator), (index), (size), CALLSITE()); \
+    } \
+} while (0)
+#else
+#define PROFILE_ALLOCATION(allocator, index, size) ((void)0)
+#endif
+
+#if defined(LATENCY_HISTOGRAMS) || defined(ALLOCATION_TRACE)
+#include <time.h>
+#endif
+
+#ifdef ALLOCATION_TRACE
+#define TRACE_EVENT(allocator, op, index, size) do { \
+    if ((allocator)->trace.records != NULL) traceEvent((allocator), (op), (index), (size)); \
+} while (0)
+#else
+#define TRACE_EVENT(allocator, op, index, size) ((void)0)
+#endif
+
+#ifdef LATENCY_HISTOGRAMS
+#define LATENCY_BEGIN() uint64_t latency_start = readTimestamp()
+#define LATENCY_END(histogram) recordLatency(&thread_latency.histogram, readTimestamp() - latency_start)
+
+static _Thread_local LatencyHistograms thread_latency;
+#else
+#define LATENCY_BEGIN() ((void)0)
+#define LATENCY_END(histogram) ((void)0)
+#endif
+
+/**
+ * @brief Text being rendered by `exportAllocatorStats`.
+ */
+typedef struct {
+    char* buffer;
+    size_t capacity;
+    size_t length;          ///< Length of the full text so far, including what did not fit.
+    StatsFormat format;
+    bool first;             ///< No JSON member has been written in the current object yet.
+} StatsWriter;
 
 /* -- Private Function Declarations --------------------------------------- */
 
 /**
- * @brief Sets the indexed bit to true.
+ * @brief Points the allocator's bitmaps into a metadata region and resets the usage counters.
+ * 
+ * @details
+ * `bitmaps.size` must already hold the number of blocks in the pool.
  * 
- * @param bitmap The bitmap to be modified
- * @param index The index of the bit to be enabled
+ * @param allocator The allocator whose bitmaps are placed
+ * @param metadata The start of the metadata region
+ * @param map_words The number of words in each bitmap
  */
-void setBit(mapSize_t* bitmap, indexSize_t index);
+void placeBitmaps(Allocator* allocator, void* metadata, indexSize_t map_words);
 
 /**
- * @brief Sets the indexed bit to false.
- * 
- * @param bitmap The bitmap to be modified
- * @param index The index of the bit to be disabled
+ * @brief Adds a free run to the fragmentation statistics.
+ *
+ * @param stats The statistics to update
+ * @param length The number of blocks in the run, which may be zero
  */
-void clearBit(mapSize_t* bitmap, indexSize_t index);
+void recordFreeRun(FragmentationStats* stats, indexSize_t length);
 
 /**
- * @brief Get the value of the indexed bit.
- * 
- * @param bitmap The bitmap to be sampled
- * @param index The index of the bit to be sampled
+ * @brief Packs a bitmap into bytes of 8 blocks each, lowest block in the lowest bit.
+ *
+ * @param allocator The allocator owning the bitmap
+ * @param bitmap The bitmap to pack
+ * @param out Receives `(bitmaps.size + 7) / 8` bytes
+ */
+void packBitmap(Allocator* allocator, mapSize_t* bitmap, uint8_t* out);
+
+/**
+ * @brief Formats a number in decimal.
+ *
+ * @param digits A buffer of at least 21 characters
+ * @param value The number to format
+ * @return The start of the digits, which end with the terminator at `digits[20]`
+ */
+char* formatNumber(char* digits, uint64_t value);
+
+/**
+ * @brief Appends text to a stats export, counting what does not fit in the buffer.
+ *
+ * @param writer The export to extend
+ * @param text The text to append
+ */
+void writeText(StatsWriter* writer, const char* text);
+
+/**
+ * @brief Starts a metric of a stats export, up to its value.
+ *
+ * @param writer The export to extend
+ * @param name The name of the metric, without the `allocator_` prefix
+ * @param type The Prometheus type of the metric
+ */
+void beginMetric(StatsWriter* writer, const char* name, const char* type);
+
+/**
+ * @brief Writes an integer metric to a stats export.
+ *
+ * @param writer The export to extend
+ * @param name The name of the metric, without the `allocator_` prefix
+ * @param type The Prometheus type of the metric
+ * @param value The value of the metric
  */
-bool getBit(mapSize_t* bitmap, indexSize_t index);
+void writeMetric(StatsWriter* writer, const char* name, const char* type, uint64_t value);
 
 /**
- * @brief Finds a contiguous sequence of free blocks.
+ * @brief Starts a metric of a stats export with one series per label value.
  *
  * @details
- * This function takes a bitmap representing used blocks, the size of the bitmap, and the number of contiguous blocks needed.
- * It iterates through each bit in the bitmap, keeping track of the count of consecutive free blocks.
- * When it finds a sequence of `num_blocks` consecutive free blocks, it returns the index of the first block in the sequence.
- * If it reaches the end of the bitmap without finding a suitable sequence, it returns SIZE_MAX.
+ * In Prometheus text this is the type line; in JSON it opens an object keyed by label value.
+ *
+ * @param writer The export to extend
+ * @param name The name of the metric, without the `allocator_` prefix
+ * @param type The Prometheus type of the metric
+ */
+void beginSeries(StatsWriter* writer, const char* name, const char* type);
+
+/**
+ * @brief Writes one series of a labeled metric to a stats export.
+ *
+ * @param writer The export to extend
+ * @param name The name of the metric, without the `allocator_` prefix
+ * @param label The label name, or NULL to write the `name_<key>` sample of a summary instead
+ * @param key The label value, or the suffix of the sample
+ * @param value The value of the series
+ */
+void writeSeries(StatsWriter* writer, const char* name, const char* label, const char* key, uint64_t value);
+
+/**
+ * @brief Ends a metric started by `beginSeries`.
+ *
+ * @param writer The export to extend
+ */
+void endSeries(StatsWriter* writer);
+
+/**
+ * @brief Finds the position of the highest set bit of a value.
+ *
+ * @param value The value to inspect
+ * @return The index of the highest set bit, or 0 if `value` is zero
+ */
+indexSize_t floorLog2(indexSize_t value);
+
+#ifdef HEAP_PROFILE
+/**
+ * @brief Records an allocation that reached the heap profile's sample point.
+ *
+ * @param allocator The allocator that made the allocation
+ * @param index The index of the allocation's head block
+ * @param size The size that was requested, in bytes
+ * @param callsite The return address of the allocating call
+ */
+void profileAllocation(Allocator* allocator, indexSize_t index, indexSize_t size, void* callsite);
+
+/**
+ * @brief Removes a deallocated allocation from the heap profile.
+ *
+ * @param allocator The allocator that owns the allocation
+ * @param index The index of the allocation's head block, whose sampled bit is set
+ */
+void forgetSample(Allocator* allocator, indexSize_t index);
+
+/**
+ * @brief Draws the number of bytes until the next heap profile sample.
+ *
+ * @param profile The profile whose generator is advanced
+ * @return A distance spread evenly over [1, 2 * interval - 1], averaging `interval`
+ */
+int64_t nextSampleDistance(HeapProfile* profile);
+#endif
+
+#ifdef ALLOCATION_TRACE
+/**
+ * @brief Appends a record to the allocator's trace buffer.
+ *
+ * @param allocator The allocator being traced
+ * @param op The operation to record
+ * @param index The index of the allocation's head block
+ * @param size The size to record, in bytes
+ */
+void traceEvent(Allocator* allocator, TraceOp op, indexSize_t index, indexSize_t size);
+#endif
+
+#if defined(LATENCY_HISTOGRAMS) || defined(ALLOCATION_TRACE)
+/**
+ * @brief Reads a cheap, monotonic timestamp.
+ *
+ * @return The time stamp counter on x86, the virtual counter on AArch64, or nanoseconds elsewhere
+ */
+uint64_t readTimestamp(void);
+#endif
+
+#ifdef LATENCY_HISTOGRAMS
+/**
+ * @brief Finds the latency histogram bucket of a duration.
+ *
+ * @param ticks The duration in timestamp ticks
+ * @return The index of the bucket holding `ticks`
+ */
+indexSize_t latencyBucket(uint64_t ticks);
+
+/**
+ * @brief Finds the largest duration held by a latency histogram bucket.
+ *
+ * @param bucket The index of the bucket
+ * @return The upper bound of the bucket
+ */
+uint64_t latencyBucketLimit(indexSize_t bucket);
+#endif
+
+/**
+ * @brief Counts the trailing zero bits of a bitmap word.
  *
- * @param num_blocks The number of contiguous blocks needed
- * @param used The bitmap representing used blocks
- * @param size The size of the bitmap
- * @return The index of the first block in the contiguous sequence if found, or MAPSIZE_MAX if not found
+ * @param word The word to inspect, which must not be zero
+ * @return The index of the lowest set bit
  */
-indexSize_t findContiguousFreeBlocks(mapSize_t num_blocks, mapSize_t* used, indexSize_t size);
+indexSize_t countTrailingZeros(mapSize_t word);
+
+/**
+ * @brief Calculates the metadata size needed for a number of bitmap words.
+ * 
+ * @details
+ * Each bitmap word covers `MAPSIZE` blocks. With `RUN_LENGTHS` defined, the side table of run lengths
+ * follows the bitmaps.
+ * 
+ * @param map_words The number of words in each bitmap
+ * @return The size of the metadata in bytes
+ */
+indexSize_t metadataSize(indexSize_t map_words);
+
+/**
+ * @brief Estimates how many blocks a memory region can hold alongside their metadata.
+ * 
+ * @details
+ * The estimate sizes the metadata, so it must never be lower than the final block count.
+ * Bitmaps cost a fraction of a byte per block and are ignored; a side table entry per block is not.
+ * 
+ * @param block_size The size of each block
+ * @param size The size of the memory region
+ * @return The upper bound on the number of blocks
+ */
+indexSize_t blockEstimate(indexSize_t block_size, indexSize_t size);
 
 /* -- Public Functions----------------------------------------------------- */
 
@@ -51,26 +274,86 @@ indexSize_t findContiguousFreeBlocks(mapSize_t num_blocks, mapSize_t* used, inde
  * - A portion of the memory will be dedicated to the bitmaps. The size of this portion 
  *   is calculated based on the number of blocks that can fit in the provided memory.
  * - The other portion of the memory will be used to store the allocated blocks.
+ * 
+ * The bitmap portion is padded to a multiple of two bitmap words, so the block portion
+ * keeps the same alignment regardless of `BITMAP_COUNT` and the optional side tables.
  */
 void initAllocator(Allocator* allocator, indexSize_t block_size, void* memory, indexSize_t size) {
     // Calculate the number of blocks that can fit in the provided memory
-    indexSize_t num_blocks = size / block_size;
+    indexSize_t num_blocks = blockEstimate(block_size, size);
     // Calculate the size of the bitmap portion of the memory region
     indexSize_t num_blocks_rounded = (num_blocks + MAPSIZE - 1) / MAPSIZE;
-    indexSize_t bitmap_size = num_blocks_rounded * 2 * sizeof(mapSize_t);
+    indexSize_t bitmap_size = metadataSize(num_blocks_rounded);
+    bitmap_size = (bitmap_size + 2 * sizeof(mapSize_t) - 1) / (2 * sizeof(mapSize_t)) * (2 * sizeof(mapSize_t));
     // Initialize the allocator with the calculated values
-    allocator->bitmaps.size = (size - bitmap_size) / block_size;  // Number of blocks in the memory region
-    allocator->bitmaps.used = (mapSize_t*)memory;  // Pointer to the used bitmap
-    // Adjust the memory pointer to the start of the allocated block portion
-    memory = (void*)((uint8_t*)memory + bitmap_size / 2);
-    allocator->bitmaps.heads = (mapSize_t*)memory;  // Pointer to the allocated bitmap
+    allocator->bitmaps.size = (bitmap_size <= size) ? (size - bitmap_size) / block_size : 0;  // Number of blocks in the memory region
+    if (allocator->bitmaps.size > num_blocks_rounded * MAPSIZE) allocator->bitmaps.size = num_blocks_rounded * MAPSIZE;
+    placeBitmaps(allocator, memory, num_blocks_rounded);  // Pointers to the bitmaps
     // Adjust the memory pointer to the start of the allocated block portion
-    memory = (void*)((uint8_t*)memory + bitmap_size / 2);
+    memory = (void*)((uint8_t*)memory + bitmap_size);
     allocator->memory.head = memory;  // Pointer to the start of the allocated block portion
     allocator->memory.size = allocator->bitmaps.size * block_size;  // Size of the allocated block portion
     allocator->block_size = block_size;  // Size of each block
 }
 
+/**
+ * @details
+ * This function lays out the memory region like `initAllocator`, but starts the block portion at the
+ * first `alignment` boundary after the bitmaps. The bitmaps are sized for every block that could fit
+ * in the whole region, so the padding never has to shrink them after the block count is known.
+ */
+indexSize_t initAllocatorAligned(Allocator* allocator, indexSize_t block_size, void* memory, indexSize_t size, indexSize_t alignment) {
+    if (alignment == 0) alignment = 1;
+    // Calculate the number of blocks that can fit in the provided memory
+    indexSize_t num_blocks = blockEstimate(block_size, size);
+    // Calculate the size of the bitmap portion of the memory region
+    indexSize_t num_blocks_rounded = (num_blocks + MAPSIZE - 1) / MAPSIZE;
+    uintptr_t bitmap_size = metadataSize(num_blocks_rounded);
+    // Pad the bitmap portion up to the next aligned address
+    uintptr_t start = (uintptr_t)memory;
+    uintptr_t head = (start + bitmap_size + alignment - 1) / alignment * alignment;
+    uintptr_t available = (head - start <= size) ? size - (head - start) : 0;
+    // Initialize the allocator with the calculated values
+    allocator->bitmaps.size = available / block_size;  // Number of blocks in the memory region
+    if (allocator->bitmaps.size > num_blocks_rounded * MAPSIZE) allocator->bitmaps.size = num_blocks_rounded * MAPSIZE;
+    placeBitmaps(allocator, memory, num_blocks_rounded);  // Pointers to the bitmaps
+    allocator->memory.head = (void*)((uint8_t*)memory + (head - start));  // Pointer to the start of the allocated block portion
+    allocator->memory.size = allocator->bitmaps.size * block_size;  // Size of the allocated block portion
+    allocator->block_size = block_size;  // Size of each block
+    // Everything that is not part of a block is overhead
+    return size - allocator->memory.size;
+}
+
+/**
+ * @details
+ * Metadata is allocated in groups covering `MAPSIZE` blocks, one word of each bitmap per group
+ * plus the entries of any side tables.
+ */
+indexSize_t allocatorMetadataSize(indexSize_t block_size, indexSize_t size) {
+    indexSize_t num_blocks = size / block_size;
+    return metadataSize((num_blocks + MAPSIZE - 1) / MAPSIZE);
+}
+
+/**
+ * @details
+ * This function initializes an allocator that manages all of `memory` as blocks, with the bitmaps
+ * placed in `metadata` instead. The metadata can then live in a different arena, e.g. a small
+ * cache-resident one, while the blocks live in a large mapped region.
+ */
+void initAllocatorExternal(Allocator* allocator, indexSize_t block_size, void* metadata, indexSize_t metadata_size, void* memory, indexSize_t size) {
+    // Calculate the number of blocks that can fit in the provided memory
+    indexSize_t num_blocks = size / block_size;
+    // Limit the blocks to the number the metadata can track
+    indexSize_t max_blocks = (metadata_size / metadataSize(1)) * MAPSIZE;
+    if (num_blocks > max_blocks) num_blocks = max_blocks;
+    // Initialize the allocator with the calculated values
+    allocator->bitmaps.size = num_blocks;  // Number of blocks in the memory region
+    placeBitmaps(allocator, metadata, (num_blocks + MAPSIZE - 1) / MAPSIZE);  // Pointers to the bitmaps
+    allocator->memory.head = memory;  // Pointer to the start of the allocated block portion
+    allocator->memory.size = num_blocks * block_size;  // Size of the allocated block portion
+    allocator->block_size = block_size;  // Size of each block
+}
+
 /**
  * @details
  * This function finds a contiguous sequence of free blocks in the allocator's bitmap and marks them as used.
@@ -78,20 +361,95 @@ void initAllocator(Allocator* allocator, indexSize_t block_size, void* memory, i
  * If no contiguous free blocks are available, it returns NULL.
  */
 void* allocate(Allocator* allocator, indexSize_t size) {
+    LATENCY_BEGIN();
     // Calculate the number of blocks needed to allocate the requested size
     indexSize_t num_blocks = (size + allocator->block_size - 1) / allocator->block_size;
     // Find the index of the first contiguous free block in the bitmap
-    indexSize_t start_index = findContiguousFreeBlocks(num_blocks, allocator->bitmaps.used, allocator->bitmaps.size);
+    indexSize_t start_index = findContiguousFreeBlocks(allocator, num_blocks);
     // If no contiguous free blocks are available, return NULL
-    if (start_index == MAPSIZE_MAX) {
+    if (start_index == INDEXSIZE_MAX) {
+        TRACE_EVENT(allocator, TRACE_FAILED, INDEXSIZE_MAX, size);
+        LATENCY_END(allocate);
         return NULL;
     }
-    // Mark the allocated blocks as used in the bitmap
+    // Mark the blocks as an allocation in the bitmaps
+    markAllocated(allocator, start_index, num_blocks, size);
+    PROFILE_ALLOCATION(allocator, start_index, size);
+    LATENCY_END(allocate);
+    // Return a pointer to the head of the allocated block
+    return (void*)((uint8_t*)allocator->memory.head + start_index * allocator->block_size);
+}
+
+/**
+ * @details
+ * This function allocates like `allocate`, then clears the allocated blocks before returning them.
+ * With `DIRTY_MAP` defined, blocks whose dirty bit is clear are still zero from initialization
+ * (or from `scrubFreeBlocks`) and are skipped.
+ */
+void* allocateZeroed(Allocator* allocator, indexSize_t size) {
+    // Calculate the number of blocks needed to allocate the requested size
+    indexSize_t num_blocks = (size + allocator->block_size - 1) / allocator->block_size;
+    // Find the index of the first contiguous free block in the bitmap
+    indexSize_t start_index = findContiguousFreeBlocks(allocator, num_blocks);
+    // If no contiguous free blocks are available, return NULL
+    if (start_index == INDEXSIZE_MAX) {
+        TRACE_EVENT(allocator, TRACE_FAILED, INDEXSIZE_MAX, size);
+        return NULL;
+    }
+    uint8_t* block = (uint8_t*)allocator->memory.head + start_index * allocator->block_size;
+#ifdef DIRTY_MAP
+    // Clear only the blocks that may have been written since they were last zero
     for (indexSize_t i = 0; i < num_blocks; i++) {
-        setBit(allocator->bitmaps.used, start_index + i);
+        if (getBit(allocator->bitmaps.dirty, start_index + i)) {
+            memset(block + i * allocator->block_size, 0, allocator->block_size);
+        }
     }
-    // Mark the allocated blocks as allocated in the bitmap
-    setBit(allocator->bitmaps.heads, start_index);
+#else
+    memset(block, 0, num_blocks * allocator->block_size);
+#endif
+    // Mark the blocks as an allocation in the bitmaps
+    markAllocated(allocator, start_index, num_blocks, size);
+    PROFILE_ALLOCATION(allocator, start_index, size);
+    return (void*)block;
+}
+
+/**
+ * @details
+ * Block `i` starts at `memory.head + i * block_size`, so the blocks meeting the alignment repeat every
+ * `alignment / gcd(block_size, alignment)` blocks. This function computes the first aligned block
+ * with a modular inverse, then searches only the aligned indices for a contiguous free sequence. If no block in the pool
+ * can ever meet the alignment, it returns NULL.
+ */
+void* allocateAligned(Allocator* allocator, indexSize_t size, indexSize_t alignment) {
+    // The alignment must be a non-zero power of two
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) return NULL;
+    // Calculate the number of blocks needed to allocate the requested size
+    indexSize_t num_blocks = (size + allocator->block_size - 1) / allocator->block_size;
+    if (num_blocks == 0) return NULL;
+    // Calculate the distance between two aligned blocks
+    indexSize_t common = 1;
+    while (common < alignment && allocator->block_size % (common * 2) == 0) common *= 2;
+    indexSize_t stride = alignment / common;
+    // Find the first aligned block: head + first * block_size must be a multiple of the alignment,
+    // so the distance to the next aligned address must be a multiple of `common`
+    uintptr_t offset = (alignment - (uintptr_t)allocator->memory.head % alignment) % alignment;
+    if (offset % common != 0) return NULL;
+    // block_size / common is odd unless the stride is 1, so it is invertible modulo the power of two
+    // `stride`; each Newton step doubles the correct low bits of the inverse, from 3 to 48
+    uint64_t odd = allocator->block_size / common;
+    uint64_t inverse = odd;
+    for (int i = 0; i < 4; i++) inverse *= 2 - odd * inverse;
+    indexSize_t first = (indexSize_t)((offset / common * inverse) & (stride - 1));
+    // Find the index of the first aligned, contiguous free block in the bitmap
+    indexSize_t start_index = findStridedFreeBlocks(allocator, num_blocks, first, stride);
+    // If no contiguous free blocks are available, return NULL
+    if (start_index == INDEXSIZE_MAX) {
+        TRACE_EVENT(allocator, TRACE_FAILED, INDEXSIZE_MAX, size);
+        return NULL;
+    }
+    // Mark the blocks as an allocation in the bitmaps
+    markAllocated(allocator, start_index, num_blocks, size);
+    PROFILE_ALLOCATION(allocator, start_index, size);
     // Return a pointer to the head of the allocated block
     return (void*)((uint8_t*)allocator->memory.head + start_index * allocator->block_size);
 }
@@ -104,46 +462,794 @@ void* allocate(Allocator* allocator, indexSize_t size) {
  * It returns true if the deallocation was successful, false otherwise.
  */
 bool deallocate(Allocator* allocator, void* ptr) {
+    LATENCY_BEGIN();
     // Calculate the index of the block in the allocator's memory
     indexSize_t index = ((uint8_t*)ptr - (uint8_t*)allocator->memory.head) / allocator->block_size;
     // Check if the block is currently allocated
-    if (!getBit(allocator->bitmaps.heads, index)) return false;
-    // Clear the allocated bit for the block
-    clearBit(allocator->bitmaps.heads, index);
-    // Traverse the bitmap, clearing the used bits for all blocks in the sequence
-    while (getBit(allocator->bitmaps.used, index) && !getBit(allocator->bitmaps.heads, index)) {
-        clearBit(allocator->bitmaps.used, index++);
-        // Break if we reach the end of the bitmap
-        if (index >= allocator->bitmaps.size) break;
+    if (!getBit(allocator->bitmaps.heads, index)) {
+        LATENCY_END(deallocate);
+        return false;
     }
+    // Clear the used and allocated bits for all blocks in the sequence
+    markFreed(allocator, index, runLength(allocator, index));
+    LATENCY_END(deallocate);
     return true;
 }
 
+/**
+ * @details
+ * This function skips the search for the end of the allocation: the span is derived from `size`,
+ * and only the heads bit of the first block and the block that follows the span are checked.
+ * The following block must be outside the pool, free, or the head of another allocation.
+ */
+bool deallocateSized(Allocator* allocator, void* ptr, indexSize_t size) {
+    indexSize_t index;
+    if (!findHead(allocator, ptr, &index)) return false;
+    // Calculate the number of blocks the allocation spans
+    indexSize_t num_blocks = (size + allocator->block_size - 1) / allocator->block_size;
+    if (num_blocks == 0 || num_blocks > allocator->bitmaps.size - index) return false;
+#ifdef RUN_LENGTHS
+    // The side table knows the exact length
+    if (num_blocks != runLength(allocator, index)) return false;
+#else
+    // Check the run terminator
+    indexSize_t end = index + num_blocks;
+    if (end < allocator->bitmaps.size && getBit(allocator->bitmaps.used, end) && !getBit(allocator->bitmaps.heads, end)) {
+        return false;
+    }
+#endif
+    // Clear the allocation
+    markFreed(allocator, index, num_blocks);
+    return true;
+}
+
+/**
+ * @details
+ * This function validates that `ptr` is the start of a block whose heads bit is set, then measures
+ * the allocation with a word-level scan of the bitmaps.
+ */
+indexSize_t allocationSize(Allocator* allocator, void* ptr) {
+    indexSize_t index;
+    if (!findHead(allocator, ptr, &index)) return 0;
+    return runLength(allocator, index) * allocator->block_size;
+}
+
+/**
+ * @details
+ * The counters are maintained by `markAllocated` and `markFreed`, so this only copies them.
+ */
+AllocatorStats getAllocatorStats(Allocator* allocator) {
+    return allocator->stats;
+}
+
+/**
+ * @details
+ * Each word of the `used` bitmap is inverted so free blocks read as ones. Words that are entirely
+ * free extend the current run and words that are entirely used end it; only mixed words are walked,
+ * one free or used stretch at a time with `countTrailingZeros`. Bits past the end of the pool count
+ * as used.
+ */
+FragmentationStats getFragmentationStats(Allocator* allocator) {
+    FragmentationStats stats = {0};
+    indexSize_t map_words = (allocator->bitmaps.size + MAPSIZE - 1) / MAPSIZE;
+    indexSize_t run = 0;
+    for (indexSize_t word = 0; word < map_words; word++) {
+        mapSize_t free_bits = (mapSize_t)~allocator->bitmaps.used[word * MAP_STRIDE];
+        // Mask off the bits past the end of the pool
+        indexSize_t tail = allocator->bitmaps.size - word * MAPSIZE;
+        if (tail < MAPSIZE) free_bits &= (mapSize_t)((1ULL << tail) - 1);
+        if (free_bits == MAPSIZE_MAX) {
+            run += MAPSIZE;
+            continue;
+        }
+        indexSize_t bit = 0;
+        while (bit < MAPSIZE) {
+            mapSize_t rest = (mapSize_t)(free_bits >> bit);
+            if (rest & 1) {
+                // The shifted-in high bits read as used, so the free stretch ends inside the word
+                indexSize_t length = countTrailingZeros((mapSize_t)~rest);
+                run += length;
+                bit += length;
+            } else {
+                recordFreeRun(&stats, run);
+                run = 0;
+                if (rest == 0) break;
+                bit += countTrailingZeros(rest);
+            }
+        }
+    }
+    recordFreeRun(&stats, run);
+    if (stats.free_blocks > 0) {
+        stats.external_fragmentation = 1.0f - (float)stats.largest_free_run / (float)stats.free_blocks;
+    }
+    return stats;
+}
+
+/**
+ * @details
+ * The counters are copied from `stats`; the bitmaps are packed a byte at a time, which takes a
+ * pass over each map but no scan for runs.
+ */
+size_t dumpAllocator(Allocator* allocator, void* buffer, size_t capacity) {
+    size_t map_bytes = ((size_t)allocator->bitmaps.size + 7) / 8;
+    size_t size = sizeof(AllocatorDumpHeader) + 2 * map_bytes;
+    if (size > capacity) return size;
+    AllocatorDumpHeader header = {
+        .magic = ALLOCATOR_DUMP_MAGIC,
+        .version = ALLOCATOR_DUMP_VERSION,
+        .mapsize = MAPSIZE,
+        .indexsize = INDEXSIZE,
+        .block_size = allocator->block_size,
+        .blocks = allocator->bitmaps.size,
+        .allocated_blocks = allocator->stats.allocated_blocks,
+        .live_allocations = allocator->stats.live_allocations,
+        .high_water_blocks = allocator->stats.high_water_blocks,
+    };
+    uint8_t* out = buffer;
+    memcpy(out, &header, sizeof(header));
+    packBitmap(allocator, allocator->bitmaps.used, out + sizeof(header));
+    packBitmap(allocator, allocator->bitmaps.heads, out + sizeof(header) + map_bytes);
+    return size;
+}
+
+/**
+ * @details
+ * The text is written through `writeText`, which keeps counting once the buffer is full, so the
+ * result tells how much to reserve. Numbers are formatted by hand, so no `printf` is linked in.
+ */
+size_t exportAllocatorStats(Allocator* allocator, StatsFormat format, char* buffer, size_t capacity) {
+    StatsWriter writer = { buffer, capacity, 0, format, true };
+    if (format == STATS_JSON) writeText(&writer, "{");
+
+    AllocatorStats stats = allocator->stats;
+    writeMetric(&writer, "block_size_bytes", "gauge", allocator->block_size);
+    writeMetric(&writer, "blocks", "gauge", allocator->bitmaps.size);
+    writeMetric(&writer, "free_blocks", "gauge", stats.free_blocks);
+    writeMetric(&writer, "allocated_blocks", "gauge", stats.allocated_blocks);
+    writeMetric(&writer, "live_allocations", "gauge", stats.live_allocations);
+    writeMetric(&writer, "high_water_blocks", "gauge", stats.high_water_blocks);
+
+    FragmentationStats fragmentation = getFragmentationStats(allocator);
+    writeMetric(&writer, "free_runs", "gauge", fragmentation.free_runs);
+    writeMetric(&writer, "largest_free_run_blocks", "gauge", fragmentation.largest_free_run);
+    // A ratio with four decimals, the fraction written as the digits of 1xxxx without the 1
+    uint64_t scaled = (uint64_t)(fragmentation.external_fragmentation * 10000.0f + 0.5f);
+    char digits[21];
+    beginMetric(&writer, "external_fragmentation", "gauge");
+    writeText(&writer, formatNumber(digits, scaled / 10000));
+    writeText(&writer, ".");
+    writeText(&writer, formatNumber(digits, 10000 + scaled % 10000) + 1);
+    if (format == STATS_PROMETHEUS) writeText(&writer, "\n");
+    // Every bucket a run in this pool can reach, so the set of series stays fixed
+    beginSeries(&writer, "free_runs_by_length", "gauge");
+    for (indexSize_t bucket = 0; bucket <= floorLog2(allocator->bitmaps.size); bucket++) {
+        writeSeries(&writer, "free_runs_by_length", "min_blocks", formatNumber(digits, 1ULL << bucket), fragmentation.histogram[bucket]);
+    }
+    endSeries(&writer);
+
+#ifdef SEARCH_COUNTERS
+    writeMetric(&writer, "searches_total", "counter", allocator->search.searches);
+    writeMetric(&writer, "search_words_visited_total", "counter", allocator->search.words_visited);
+    writeMetric(&writer, "search_bits_examined_total", "counter", allocator->search.bits_examined);
+    writeMetric(&writer, "search_restarts_total", "counter", allocator->search.restarts);
+    writeMetric(&writer, "failed_searches_total", "counter", allocator->search.failed_searches);
+    writeMetric(&writer, "run_words_visited_total", "counter", allocator->search.run_words_visited);
+#endif
+
+#ifdef SIZE_ACCOUNTING
+    writeMetric(&writer, "allocations_total", "counter", allocator->sizes.total.allocations);
+    writeMetric(&writer, "requested_bytes_total", "counter", allocator->sizes.total.requested_bytes);
+    writeMetric(&writer, "granted_bytes_total", "counter", allocator->sizes.total.granted_bytes);
+#endif
+
+#ifdef LATENCY_HISTOGRAMS
+    const char* const latency_names[] = { "allocate_latency_ticks", "deallocate_latency_ticks" };
+    const LatencyHistogram* histograms[] = { &thread_latency.allocate, &thread_latency.deallocate };
+    for (int i = 0; i < 2; i++) {
+        LatencySummary summary = summarizeLatency(histograms[i]);
+        beginSeries(&writer, latency_names[i], "summary");
+        writeSeries(&writer, latency_names[i], "quantile", "0.5", summary.p50);
+        writeSeries(&writer, latency_names[i], "quantile", "0.99", summary.p99);
+        writeSeries(&writer, latency_names[i], "quantile", "0.999", summary.p999);
+        writeSeries(&writer, latency_names[i], NULL, "sum", summary.sum);
+        writeSeries(&writer, latency_names[i], NULL, "count", summary.count);
+        endSeries(&writer);
+    }
+#endif
+
+    if (format == STATS_JSON) writeText(&writer, "}");
+    if (capacity > 0) buffer[(writer.length < capacity) ? writer.length : capacity - 1] = '\0';
+    return writer.length;
+}
+
+#ifdef LATENCY_HISTOGRAMS
+/**
+ * @details
+ * Each thread gets its own zero-initialized histograms, so recording never contends between threads.
+ */
+LatencyHistograms* getThreadLatency(void) {
+    return &thread_latency;
+}
+
+void recordLatency(LatencyHistogram* histogram, uint64_t ticks) {
+    histogram->count++;
+    histogram->sum += ticks;
+    histogram->buckets[latencyBucket(ticks)]++;
+}
+
+void mergeLatency(LatencyHistogram* into, const LatencyHistogram* from) {
+    into->count += from->count;
+    into->sum += from->sum;
+    for (indexSize_t i = 0; i < LATENCY_BUCKETS; i++) into->buckets[i] += from->buckets[i];
+}
+
+/**
+ * @details
+ * The buckets are walked from the shortest durations until they hold the requested share of the
+ * recorded durations, rounded up, so the result may overstate the percentile by one bucket width.
+ */
+uint64_t latencyPercentile(const LatencyHistogram* histogram, uint32_t per_mille) {
+    if (histogram->count == 0) return 0;
+    uint64_t rank = (histogram->count * per_mille + 999) / 1000;
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (indexSize_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) return latencyBucketLimit(i);
+    }
+    return latencyBucketLimit(LATENCY_BUCKETS - 1);
+}
+
+LatencySummary summarizeLatency(const LatencyHistogram* histogram) {
+    LatencySummary summary;
+    summary.count = histogram->count;
+    summary.sum = histogram->sum;
+    summary.p50 = latencyPercentile(histogram, 500);
+    summary.p99 = latencyPercentile(histogram, 990);
+    summary.p999 = latencyPercentile(histogram, 999);
+    return summary;
+}
+#endif
+
+#ifdef SEARCH_COUNTERS
+/**
+ * @details
+ * The counters are incremented where the events happen, so this only copies them.
+ */
+SearchCounters getSearchCounters(Allocator* allocator) {
+    return allocator->search;
+}
+#endif
+
+#ifdef SIZE_ACCOUNTING
+/**
+ * @details
+ * The accounting is updated by `markAllocated`, so this only exposes it.
+ */
+const SizeAccounting* getSizeAccounting(Allocator* allocator) {
+    return &allocator->sizes;
+}
+#endif
+
+#ifdef ALLOCATION_TRACE
+void setTraceBuffer(Allocator* allocator, TraceRecord* records, uint64_t capacity) {
+    allocator->trace.records = (capacity > 0) ? records : NULL;
+    allocator->trace.capacity = capacity;
+    allocator->trace.written = 0;
+}
+#endif
+
+#ifdef HEAP_PROFILE
+void setHeapProfileInterval(Allocator* allocator, uint64_t interval) {
+    allocator->profile.interval = interval;
+    allocator->profile.countdown = interval ? nextSampleDistance(&allocator->profile) : 0;
+}
+
+/**
+ * @details
+ * Call sites are merged by a linear search of the entries written so far, then sorted by insertion,
+ * so no memory is allocated. Both are bounded by `HEAP_PROFILE_SLOTS`.
+ */
+indexSize_t dumpHeapProfile(Allocator* allocator, CallsiteProfile* callsites, indexSize_t capacity) {
+    indexSize_t count = 0;
+    for (indexSize_t slot = 0; slot < HEAP_PROFILE_SLOTS; slot++) {
+        HeapSample* sample = &allocator->profile.samples[slot];
+        if (sample->callsite == NULL) continue;
+        // Find the call site's entry, or start a new one
+        indexSize_t entry = 0;
+        while (entry < count && callsites[entry].callsite != sample->callsite) entry++;
+        if (entry == count) {
+            if (count == capacity) continue;
+            callsites[entry].callsite = sample->callsite;
+            callsites[entry].samples = 0;
+            callsites[entry].sampled_bytes = 0;
+            callsites[entry].estimated_bytes = 0;
+            count++;
+        }
+        callsites[entry].samples++;
+        callsites[entry].sampled_bytes += sample->size;
+        callsites[entry].estimated_bytes += (sample->size > allocator->profile.interval) ? sample->size : allocator->profile.interval;
+    }
+    // Largest estimate first
+    for (indexSize_t i = 1; i < count; i++) {
+        CallsiteProfile entry = callsites[i];
+        indexSize_t j = i;
+        while (j > 0 && callsites[j - 1].estimated_bytes < entry.estimated_bytes) {
+            callsites[j] = callsites[j - 1];
+            j--;
+        }
+        callsites[j] = entry;
+    }
+    return count;
+}
+#endif
+
+#ifdef DIRTY_MAP
+/**
+ * @details
+ * This function walks the pool from where the previous call stopped, zeroing blocks that are
+ * free but dirty and clearing their dirty bits. It stops after `max_blocks` blocks have been
+ * cleared or once the whole pool has been visited.
+ */
+indexSize_t scrubFreeBlocks(Allocator* allocator, indexSize_t max_blocks) {
+    indexSize_t scrubbed = 0;
+    indexSize_t index = allocator->scrub_index;
+    for (indexSize_t visited = 0; visited < allocator->bitmaps.size && scrubbed < max_blocks; visited++) {
+        if (index >= allocator->bitmaps.size) index = 0;
+        if (getBit(allocator->bitmaps.dirty, index) && !getBit(allocator->bitmaps.used, index)) {
+            memset((uint8_t*)allocator->memory.head + index * allocator->block_size, 0, allocator->block_size);
+            clearBit(allocator->bitmaps.dirty, index);
+            scrubbed++;
+        }
+        index++;
+    }
+    allocator->scrub_index = index;
+    return scrubbed;
+}
+#endif
+
 /* -- Private Functions --------------------------------------------------- */
 
-indexSize_t findContiguousFreeBlocks(mapSize_t num_blocks, mapSize_t* used, indexSize_t size) {
+indexSize_t findContiguousFreeBlocks(Allocator* allocator, indexSize_t num_blocks) {
+    mapSize_t* used = allocator->bitmaps.used;
+    indexSize_t size = allocator->bitmaps.size;
+    COUNT_EVENT(allocator, searches);
     indexSize_t count = 0; // Initialize a counter to track consecutive free blocks
     for (indexSize_t i = 0; i < size; i++) { // Iterate through each bit in the bitmap
+        if (i % MAPSIZE == 0) COUNT_EVENT(allocator, words_visited);
+        COUNT_EVENT(allocator, bits_examined);
         if (!getBit(used, i)) { // If the bit is not set (i.e., the block is free)
             count++; // Increment the counter
             if (count == num_blocks) { // If the counter equals the number of blocks needed
                 return i - num_blocks + 1; // Return the starting index of the sequence
             }
         } else { // If the bit is set (i.e., the block is used)
+            if (count > 0) COUNT_EVENT(allocator, restarts);
             count = 0; // Reset the counter
         }
     }
-    return MAPSIZE_MAX; // Return MAPSIZE_MAX if no suitable sequence is found
+    COUNT_EVENT(allocator, failed_searches);
+    return INDEXSIZE_MAX; // Return INDEXSIZE_MAX if no suitable sequence is found
+}
+
+indexSize_t findStridedFreeBlocks(Allocator* allocator, indexSize_t num_blocks, indexSize_t first, indexSize_t stride) {
+    mapSize_t* used = allocator->bitmaps.used;
+    indexSize_t size = allocator->bitmaps.size;
+    COUNT_EVENT(allocator, searches);
+    if (num_blocks > size) {
+        COUNT_EVENT(allocator, failed_searches);
+        return INDEXSIZE_MAX;
+    }
+    indexSize_t candidate = first;
+    while (candidate <= size - num_blocks) {
+        // Check the candidate sequence from its last block backwards
+        indexSize_t remaining = num_blocks;
+        while (remaining > 0) {
+            indexSize_t index = candidate + remaining - 1;
+            if (remaining == num_blocks || index % MAPSIZE == MAPSIZE - 1) COUNT_EVENT(allocator, words_visited);
+            COUNT_EVENT(allocator, bits_examined);
+            if (getBit(used, index)) break;
+            remaining--;
+        }
+        if (remaining == 0) return candidate;
+        COUNT_EVENT(allocator, restarts);
+        // Every candidate that overlaps the used block is ruled out, skip to the next one past it
+        indexSize_t blocked = candidate + remaining;
+        indexSize_t skip = (blocked - candidate + stride - 1) / stride * stride;
+        if (skip > size - candidate) break;
+        candidate += skip;
+    }
+    COUNT_EVENT(allocator, failed_searches);
+    return INDEXSIZE_MAX;
+}
+
+indexSize_t runLength(Allocator* allocator, indexSize_t index) {
+#ifdef RUN_LENGTHS
+    if (allocator->bitmaps.lengths[index] != RUN_LENGTH_MAX) return allocator->bitmaps.lengths[index];
+    // Longer runs keep their full length in the entries of the blocks that follow the head
+    indexSize_t length;
+    memcpy(&length, &allocator->bitmaps.lengths[index + 1], sizeof(length));
+    return length;
+#else
+    indexSize_t end = index + 1;
+    while (end < allocator->bitmaps.size) {
+        COUNT_EVENT(allocator, run_words_visited);
+        indexSize_t word = (end / MAPSIZE) * MAP_STRIDE;
+        indexSize_t bit = end % MAPSIZE;
+        // Blocks that end the run: free blocks and the heads of other allocations
+        mapSize_t stop = (mapSize_t)(~allocator->bitmaps.used[word] | allocator->bitmaps.heads[word]);
+        stop = (mapSize_t)(stop >> bit);
+        if (stop != 0) {
+            end += countTrailingZeros(stop);
+            break;
+        }
+        end += MAPSIZE - bit;
+    }
+    // Runs never extend past the end of the pool
+    if (end > allocator->bitmaps.size) end = allocator->bitmaps.size;
+    return end - index;
+#endif
+}
+
+bool findHead(Allocator* allocator, void* ptr, indexSize_t* index) {
+    // Reject pointers outside the block portion or not on a block boundary
+    if ((uint8_t*)ptr < (uint8_t*)allocator->memory.head) return false;
+    uintptr_t offset = (uint8_t*)ptr - (uint8_t*)allocator->memory.head;
+    if (offset >= allocator->memory.size || offset % allocator->block_size != 0) return false;
+    // Calculate the index of the block in the allocator's memory
+    *index = offset / allocator->block_size;
+    // Check if the block is currently allocated
+    return getBit(allocator->bitmaps.heads, *index);
+}
+
+void recordFreeRun(FragmentationStats* stats, indexSize_t length) {
+    if (length == 0) return;
+    stats->free_blocks += length;
+    stats->free_runs++;
+    if (length > stats->largest_free_run) stats->largest_free_run = length;
+    stats->histogram[floorLog2(length)]++;
+}
+
+void packBitmap(Allocator* allocator, mapSize_t* bitmap, uint8_t* out) {
+    uint64_t size = allocator->bitmaps.size;
+    // A word holds a whole number of bytes, so no byte straddles two words; the wider index cannot wrap
+    for (uint64_t index = 0; index < size; index += 8) {
+        uint8_t byte = (uint8_t)(bitmap[(index / MAPSIZE) * MAP_STRIDE] >> (index % MAPSIZE));
+        // Clear the bits past the end of the pool
+        if (size - index < 8) byte &= (uint8_t)((1u << (size - index)) - 1);
+        *out++ = byte;
+    }
+}
+
+char* formatNumber(char* digits, uint64_t value) {
+    char* at = digits + 20;
+    *at = '\0';
+    do {
+        *--at = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    return at;
+}
+
+void writeText(StatsWriter* writer, const char* text) {
+    for (; *text != '\0'; text++) {
+        // The last byte of the buffer is kept for the terminator
+        if (writer->length + 1 < writer->capacity) writer->buffer[writer->length] = *text;
+        writer->length++;
+    }
+}
+
+void beginMetric(StatsWriter* writer, const char* name, const char* type) {
+    if (writer->format == STATS_PROMETHEUS) {
+        writeText(writer, "# TYPE allocator_");
+        writeText(writer, name);
+        writeText(writer, " ");
+        writeText(writer, type);
+        writeText(writer, "\nallocator_");
+        writeText(writer, name);
+        writeText(writer, " ");
+    } else {
+        writeText(writer, writer->first ? "\"" : ",\"");
+        writeText(writer, name);
+        writeText(writer, "\":");
+        writer->first = false;
+    }
+}
+
+void writeMetric(StatsWriter* writer, const char* name, const char* type, uint64_t value) {
+    char digits[21];
+    beginMetric(writer, name, type);
+    writeText(writer, formatNumber(digits, value));
+    if (writer->format == STATS_PROMETHEUS) writeText(writer, "\n");
+}
+
+void beginSeries(StatsWriter* writer, const char* name, const char* type) {
+    if (writer->format == STATS_PROMETHEUS) {
+        writeText(writer, "# TYPE allocator_");
+        writeText(writer, name);
+        writeText(writer, " ");
+        writeText(writer, type);
+        writeText(writer, "\n");
+    } else {
+        writeText(writer, writer->first ? "\"" : ",\"");
+        writeText(writer, name);
+        writeText(writer, "\":{");
+        writer->first = true;
+    }
+}
+
+void writeSeries(StatsWriter* writer, const char* name, const char* label, const char* key, uint64_t value) {
+    char digits[21];
+    if (writer->format == STATS_PROMETHEUS) {
+        writeText(writer, "allocator_");
+        writeText(writer, name);
+        writeText(writer, label ? "{" : "_");
+        if (label) {
+            writeText(writer, label);
+            writeText(writer, "=\"");
+        }
+        writeText(writer, key);
+        writeText(writer, label ? "\"} " : " ");
+        writeText(writer, formatNumber(digits, value));
+        writeText(writer, "\n");
+    } else {
+        writeText(writer, writer->first ? "\"" : ",\"");
+        writeText(writer, key);
+        writeText(writer, "\":");
+        writeText(writer, formatNumber(digits, value));
+        writer->first = false;
+    }
+}
+
+void endSeries(StatsWriter* writer) {
+    if (writer->format == STATS_JSON) writeText(writer, "}");
+    writer->first = false;
+}
+
+indexSize_t floorLog2(indexSize_t value) {
+    indexSize_t log = 0;
+    while (value >>= 1) log++;
+    return log;
+}
+
+#ifdef HEAP_PROFILE
+void profileAllocation(Allocator* allocator, indexSize_t index, indexSize_t size, void* callsite) {
+    HeapProfile* profile = &allocator->profile;
+    profile->countdown = nextSampleDistance(profile);
+    // Record the allocation in a free slot
+    for (indexSize_t slot = 0; slot < HEAP_PROFILE_SLOTS; slot++) {
+        if (profile->samples[slot].callsite == NULL) {
+            profile->samples[slot].callsite = callsite;
+            profile->samples[slot].index = index;
+            profile->samples[slot].size = size;
+            setBit(allocator->bitmaps.sampled, index);
+            return;
+        }
+    }
+    profile->dropped++;
+}
+
+void forgetSample(Allocator* allocator, indexSize_t index) {
+    clearBit(allocator->bitmaps.sampled, index);
+    for (indexSize_t slot = 0; slot < HEAP_PROFILE_SLOTS; slot++) {
+        if (allocator->profile.samples[slot].callsite != NULL && allocator->profile.samples[slot].index == index) {
+            allocator->profile.samples[slot].callsite = NULL;
+            return;
+        }
+    }
+}
+
+int64_t nextSampleDistance(HeapProfile* profile) {
+    // xorshift32
+    uint32_t x = profile->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    profile->seed = x;
+    return 1 + (int64_t)(x % (2 * profile->interval - 1));
+}
+#endif
+
+#ifdef ALLOCATION_TRACE
+void traceEvent(Allocator* allocator, TraceOp op, indexSize_t index, indexSize_t size) {
+    AllocationTrace* trace = &allocator->trace;
+    TraceRecord* record = &trace->records[trace->written % trace->capacity];
+    record->time_op = (readTimestamp() << 8) | (uint64_t)op;
+    record->index = (uint32_t)index;
+    record->size = (uint32_t)size;
+    trace->written++;
+}
+#endif
+
+#if defined(LATENCY_HISTOGRAMS) || defined(ALLOCATION_TRACE)
+uint64_t readTimestamp(void) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_ia32_rdtsc();
+#elif defined(__GNUC__) && defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+#endif
+
+#ifdef LATENCY_HISTOGRAMS
+
+indexSize_t latencyBucket(uint64_t ticks) {
+    // Short durations get a bucket each
+    if (ticks < (2u << LATENCY_SUB_BITS)) return (indexSize_t)ticks;
+    indexSize_t log = 0;
+    for (uint64_t value = ticks; value >>= 1;) log++;
+    // The bits below the leading one select the sub-bucket
+    indexSize_t sub = (indexSize_t)(ticks >> (log - LATENCY_SUB_BITS)) & ((1u << LATENCY_SUB_BITS) - 1);
+    return ((log - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS) + sub;
+}
+
+uint64_t latencyBucketLimit(indexSize_t bucket) {
+    if (bucket < (2u << LATENCY_SUB_BITS)) return bucket;
+    indexSize_t shift = (bucket >> LATENCY_SUB_BITS) - 1;
+    uint64_t lower = (uint64_t)((1u << LATENCY_SUB_BITS) + (bucket & ((1u << LATENCY_SUB_BITS) - 1))) << shift;
+    return lower + ((uint64_t)1 << shift) - 1;
+}
+#endif
+
+indexSize_t countTrailingZeros(mapSize_t word) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(word);
+#else
+    indexSize_t count = 0;
+    while ((word & 1) == 0) {
+        word >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+void placeBitmaps(Allocator* allocator, void* metadata, indexSize_t map_words) {
+#ifdef RUN_LENGTHS
+    // The side table starts after the bitmaps
+    allocator->bitmaps.lengths = (runLength_t*)((uint8_t*)metadata + map_words * BITMAP_COUNT * sizeof(mapSize_t));
+#endif
+#ifdef INTERLEAVE_MAPS
+    // Each map starts at its own word of the first group
+    map_words = 1;
+#endif
+    allocator->bitmaps.used = (mapSize_t*)metadata;  // Pointer to the used bitmap
+    allocator->bitmaps.heads = allocator->bitmaps.used + map_words;  // Pointer to the allocated bitmap
+#ifdef DIRTY_MAP
+    allocator->bitmaps.dirty = allocator->bitmaps.heads + map_words;  // Pointer to the dirty bitmap
+    allocator->scrub_index = 0;
+#endif
+#ifdef HEAP_PROFILE
+    allocator->bitmaps.sampled = allocator->bitmaps.used + (BITMAP_COUNT - 1) * map_words;  // Pointer to the sampled bitmap
+    memset(&allocator->profile, 0, sizeof(allocator->profile));
+    allocator->profile.seed = 2463534242u;
+    setHeapProfileInterval(allocator, HEAP_PROFILE_INTERVAL);
+#endif
+    // Every block starts out free
+    allocator->stats.free_blocks = allocator->bitmaps.size;
+    allocator->stats.allocated_blocks = 0;
+    allocator->stats.live_allocations = 0;
+    allocator->stats.high_water_blocks = 0;
+#ifdef SEARCH_COUNTERS
+    memset(&allocator->search, 0, sizeof(allocator->search));
+#endif
+#ifdef ALLOCATION_TRACE
+    setTraceBuffer(allocator, NULL, 0);
+#endif
+#ifdef SIZE_ACCOUNTING
+    memset(&allocator->sizes, 0, sizeof(allocator->sizes));
+#endif
+}
+
+indexSize_t blockEstimate(indexSize_t block_size, indexSize_t size) {
+#ifdef RUN_LENGTHS
+    // Every block also needs an entry in the side table
+    return size / (block_size + sizeof(runLength_t));
+#else
+    return size / block_size;
+#endif
+}
+
+indexSize_t metadataSize(indexSize_t map_words) {
+    indexSize_t size = map_words * BITMAP_COUNT * sizeof(mapSize_t);
+#ifdef RUN_LENGTHS
+    size += map_words * MAPSIZE * sizeof(runLength_t);
+#endif
+    return size;
+}
+
+void markAllocated(Allocator* allocator, indexSize_t start_index, indexSize_t num_blocks, indexSize_t size) {
+    // Mark the allocated blocks as used in the bitmap
+    setBits(allocator->bitmaps.used, start_index, num_blocks);
+#ifdef DIRTY_MAP
+    // The caller may write to the blocks from now on
+    setBits(allocator->bitmaps.dirty, start_index, num_blocks);
+#endif
+    // Mark the allocated blocks as allocated in the bitmap
+    setBit(allocator->bitmaps.heads, start_index);
+#ifdef RUN_LENGTHS
+    if (num_blocks < RUN_LENGTH_MAX) {
+        allocator->bitmaps.lengths[start_index] = (runLength_t)num_blocks;
+    } else {
+        // The entries of the blocks after the head are unused, and there are enough of them
+        allocator->bitmaps.lengths[start_index] = RUN_LENGTH_MAX;
+        memcpy(&allocator->bitmaps.lengths[start_index + 1], &num_blocks, sizeof(num_blocks));
+    }
+#endif
+    // Update the usage counters
+    allocator->stats.free_blocks -= num_blocks;
+    allocator->stats.allocated_blocks += num_blocks;
+    allocator->stats.live_allocations++;
+    if (allocator->stats.allocated_blocks > allocator->stats.high_water_blocks) {
+        allocator->stats.high_water_blocks = allocator->stats.allocated_blocks;
+    }
+#ifdef SIZE_ACCOUNTING
+    // Record the rounding waste of the request
+    uint64_t granted = (uint64_t)num_blocks * allocator->block_size;
+    SizeBucket* bucket = &allocator->sizes.buckets[floorLog2(size)];
+    allocator->sizes.total.allocations++;
+    allocator->sizes.total.requested_bytes += size;
+    allocator->sizes.total.granted_bytes += granted;
+    bucket->allocations++;
+    bucket->requested_bytes += size;
+    bucket->granted_bytes += granted;
+#else
+    (void)size;
+#endif
+    TRACE_EVENT(allocator, TRACE_ALLOCATE, start_index, size);
+}
+
+void markFreed(Allocator* allocator, indexSize_t start_index, indexSize_t num_blocks) {
+    // Clear the used bits for all blocks in the sequence
+    clearBits(allocator->bitmaps.used, start_index, num_blocks);
+    // Clear the allocated bit for the head block
+    clearBit(allocator->bitmaps.heads, start_index);
+    // Update the usage counters
+    allocator->stats.free_blocks += num_blocks;
+    allocator->stats.allocated_blocks -= num_blocks;
+    allocator->stats.live_allocations--;
+#ifdef HEAP_PROFILE
+    if (getBit(allocator->bitmaps.sampled, start_index)) forgetSample(allocator, start_index);
+#endif
+    TRACE_EVENT(allocator, TRACE_DEALLOCATE, start_index, num_blocks * allocator->block_size);
 }
 
 void setBit(mapSize_t* bitmap, indexSize_t index) {
-    bitmap[index / MAPSIZE] |= (1ULL << (index % MAPSIZE));
+    bitmap[(index / MAPSIZE) * MAP_STRIDE] |= (1ULL << (index % MAPSIZE));
 }
 
 void clearBit(mapSize_t* bitmap, indexSize_t index) {
-    bitmap[index / MAPSIZE] &= ~(1ULL << (index % MAPSIZE));
+    bitmap[(index / MAPSIZE) * MAP_STRIDE] &= ~(1ULL << (index % MAPSIZE));
 }
 
 bool getBit(mapSize_t* bitmap, indexSize_t index) {
-    return (bitmap[index / MAPSIZE] & (1ULL << (index % MAPSIZE))) != 0;
+    return (bitmap[(index / MAPSIZE) * MAP_STRIDE] & (1ULL << (index % MAPSIZE))) != 0;
 }
+
+void setBits(mapSize_t* bitmap, indexSize_t index, indexSize_t count) {
+    while (count > 0) {
+        // Set the part of the range that falls in the current word
+        indexSize_t bit = index % MAPSIZE;
+        indexSize_t span = (count < MAPSIZE - bit) ? count : MAPSIZE - bit;
+        bitmap[(index / MAPSIZE) * MAP_STRIDE] |= (mapSize_t)(((1ULL << span) - 1) << bit);
+        index += span;
+        count -= span;
+    }
+}
+
+void clearBits(mapSize_t* bitmap, indexSize_t index, indexSize_t count) {
+    while (count > 0) {
+        // Clear the part of the range that falls in the current word
+        indexSize_t bit = index % MAPSIZE;
+        indexSize_t span = (count < MAPSIZE - bit) ? count : MAPSIZE - bit;
+        bitmap[(index / MAPSIZE) * MAP_STRIDE] &= (mapSize_t)~(((1ULL << span) - 1) << bit);
+        index += span;
+        count -= span;
+    }
+}
\ No newline at end of file
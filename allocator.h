@@ -14,6 +14,7 @@
 #endif
 
 #define MAPSIZE_MAX FWD_MAX(MAPSIZE)
+#define INDEXSIZE_MAX FWD_MAX(INDEXSIZE)
 #define FWD_MAX(arg) MAX_ARG(arg)
 #define MAX_ARG(arg) UINT##arg##_MAX
 
@@ -25,6 +26,57 @@
 typedef MAPSIZE_TYPE mapSize_t;
 typedef INDEXSIZE_TYPE indexSize_t;
 
+/*
+ * Optional features, enabled by defining the macro in the compiler tooling:
+ * - DIRTY_MAP: adds a third bitmap recording which blocks have ever been handed out,
+ *   so `allocateZeroed` only clears blocks that may hold stale data.
+ * - INTERLEAVE_MAPS: stores the bitmaps word by word in a single array instead of one after another,
+ *   so the words describing the same blocks share a cache line. Word `w` of each map is then found at
+ *   `map[w * MAP_STRIDE]`.
+ * - RUN_LENGTHS: keeps a side table with the length of each allocation at its head index, so freeing
+ *   and size queries do not depend on the allocation's length. This costs one byte per block; lengths
+ *   of `RUN_LENGTH_MAX` blocks or more are stored in the unused entries after the head. Without the
+ *   option, lengths are recovered from the bitmaps.
+ * - LATENCY_HISTOGRAMS: times every `allocate` and `deallocate` call and records the duration in
+ *   log-bucketed histograms kept per thread, which can be merged and queried for percentiles.
+ * - SEARCH_COUNTERS: counts the work done by the free block search and by deallocation, so slow
+ *   calls can be attributed to bitmap words visited, bits examined or restarted searches.
+ * - SIZE_ACCOUNTING: records the requested and granted bytes of every allocation, in total and per
+ *   power-of-two bucket of the requested size, so the rounding waste of `block_size` can be measured.
+ * - ALLOCATION_TRACE: appends a compact record of every allocation, deallocation and failed allocation
+ *   to a caller-provided ring buffer, so real workloads can be saved and replayed offline.
+ * - HEAP_PROFILE: samples allocations about every `interval` bytes and records their call site, so the
+ *   live sampled allocations can be dumped by call site. A bitmap marks the sampled heads, so
+ *   deallocating an unsampled allocation costs one bit test.
+ */
+#if defined(DIRTY_MAP) && defined(HEAP_PROFILE)
+#define BITMAP_COUNT 4
+#elif defined(DIRTY_MAP) || defined(HEAP_PROFILE)
+#define BITMAP_COUNT 3
+#else
+#define BITMAP_COUNT 2
+#endif
+
+#ifdef HEAP_PROFILE
+#ifndef HEAP_PROFILE_SLOTS
+#define HEAP_PROFILE_SLOTS 64   ///< Maximum number of live sampled allocations.
+#endif
+#ifndef HEAP_PROFILE_INTERVAL
+#define HEAP_PROFILE_INTERVAL 65536 ///< Default mean number of bytes allocated between samples.
+#endif
+#endif
+
+#ifdef RUN_LENGTHS
+typedef uint8_t runLength_t;
+#define RUN_LENGTH_MAX UINT8_MAX
+#endif
+
+#ifdef INTERLEAVE_MAPS
+#define MAP_STRIDE BITMAP_COUNT
+#else
+#define MAP_STRIDE 1
+#endif
+
 /**
  * @brief A block of memory with a pointer to its head and its size.
  */
@@ -39,9 +91,227 @@ typedef struct {
 typedef struct {
     mapSize_t* used;    ///< Bitmap tracking used blocks.
     mapSize_t* heads;   ///< Bitmap tracking allocated block heads.
+#ifdef DIRTY_MAP
+    mapSize_t* dirty;   ///< Bitmap tracking blocks that may hold non-zero data.
+#endif
+#ifdef HEAP_PROFILE
+    mapSize_t* sampled; ///< Bitmap tracking allocation heads recorded by the heap profile.
+#endif
+#ifdef RUN_LENGTHS
+    runLength_t* lengths; ///< Number of blocks in each allocation, indexed by its head block.
+#endif
     indexSize_t size;   ///< Size of the bitmap.
 } BitMaps;
 
+/**
+ * @brief Usage counters of an allocator, kept up to date by every allocation and deallocation.
+ */
+typedef struct {
+    indexSize_t free_blocks;        ///< Number of blocks that are not part of an allocation.
+    indexSize_t allocated_blocks;   ///< Number of blocks that are part of an allocation.
+    indexSize_t live_allocations;   ///< Number of allocations that have not been deallocated.
+    indexSize_t high_water_blocks;  ///< Largest value `allocated_blocks` has reached.
+} AllocatorStats;
+
+/**
+ * @brief Number of buckets in the free run histogram, one per power of two a run length can reach.
+ */
+#define FREE_RUN_BUCKETS INDEXSIZE
+
+/**
+ * @brief Layout of the free blocks of an allocator.
+ */
+typedef struct {
+    indexSize_t free_blocks;        ///< Number of blocks that are not part of an allocation.
+    indexSize_t free_runs;          ///< Number of maximal sequences of contiguous free blocks.
+    indexSize_t largest_free_run;   ///< Length of the longest free run, the largest allocation that can succeed.
+    indexSize_t histogram[FREE_RUN_BUCKETS]; ///< Free runs counted by length; bucket `i` holds lengths in [2^i, 2^(i+1)).
+    float external_fragmentation;   ///< `1 - largest_free_run / free_blocks`, or 0 if no block is free.
+} FragmentationStats;
+
+/**
+ * @brief Identifies a snapshot written by `dumpAllocator`, "ALCBMAPS" read as a little-endian integer.
+ */
+#define ALLOCATOR_DUMP_MAGIC 0x5350414D42434C41ULL
+#define ALLOCATOR_DUMP_VERSION 1
+
+/**
+ * @brief Header of a snapshot written by `dumpAllocator`.
+ *
+ * @details
+ * The header is followed by the `used` bitmap and then the `heads` bitmap, each packed into
+ * `(blocks + 7) / 8` bytes with block `i` at bit `i % 8` of byte `i / 8`, so a snapshot reads the
+ * same whatever `MAPSIZE` and `INTERLEAVE_MAPS` the allocator was built with.
+ */
+typedef struct {
+    uint64_t magic;                 ///< `ALLOCATOR_DUMP_MAGIC`.
+    uint32_t version;               ///< `ALLOCATOR_DUMP_VERSION`.
+    uint16_t mapsize;               ///< `MAPSIZE` of the allocator's build.
+    uint16_t indexsize;             ///< `INDEXSIZE` of the allocator's build.
+    uint64_t block_size;            ///< Size of each block, in bytes.
+    uint64_t blocks;                ///< Number of blocks in the pool.
+    uint64_t allocated_blocks;      ///< Number of blocks that are part of an allocation.
+    uint64_t live_allocations;      ///< Number of allocations that have not been deallocated.
+    uint64_t high_water_blocks;     ///< Largest number of blocks allocated at once.
+} AllocatorDumpHeader;
+
+/**
+ * @brief Text formats `exportAllocatorStats` can render.
+ */
+typedef enum {
+    STATS_PROMETHEUS,   ///< Prometheus text exposition format, every metric named `allocator_<name>`.
+    STATS_JSON,         ///< One JSON object, keyed by the same names without the prefix.
+} StatsFormat;
+
+#ifdef SIZE_ACCOUNTING
+/**
+ * @brief Number of request size buckets, one per power of two a requested size can reach.
+ */
+#define SIZE_BUCKETS INDEXSIZE
+
+/**
+ * @brief Requested and granted bytes of a set of allocations.
+ */
+typedef struct {
+    uint64_t allocations;       ///< Number of successful allocations.
+    uint64_t requested_bytes;   ///< Sum of the sizes passed to the allocation functions.
+    uint64_t granted_bytes;     ///< Sum of the sizes after rounding up to whole blocks.
+} SizeBucket;
+
+/**
+ * @brief Rounding waste of an allocator, accumulated since initialization.
+ */
+typedef struct {
+    SizeBucket total;                   ///< Every allocation.
+    SizeBucket buckets[SIZE_BUCKETS];   ///< Allocations by requested size; bucket `i` holds sizes in [2^i, 2^(i+1)), and size 0.
+} SizeAccounting;
+#endif
+
+#ifdef LATENCY_HISTOGRAMS
+/**
+ * @brief Number of sub-buckets each power of two is split into, as a power of two.
+ */
+#define LATENCY_SUB_BITS 2
+
+/**
+ * @brief Number of buckets in a latency histogram, enough for any 64-bit duration.
+ */
+#define LATENCY_BUCKETS (64 << LATENCY_SUB_BITS)
+
+/**
+ * @brief Distribution of call durations in timestamp ticks.
+ *
+ * @details
+ * Durations below `2^(LATENCY_SUB_BITS + 1)` ticks have a bucket each; above that, every power of two
+ * is split into `2^LATENCY_SUB_BITS` equal buckets, so a bucket spans at most 25% of its values.
+ */
+typedef struct {
+    uint64_t count;                     ///< Number of recorded durations.
+    uint64_t sum;                       ///< Sum of the recorded durations.
+    uint64_t buckets[LATENCY_BUCKETS];  ///< Number of recorded durations in each bucket.
+} LatencyHistogram;
+
+/**
+ * @brief Latency histograms of the allocator calls made by one thread.
+ */
+typedef struct {
+    LatencyHistogram allocate;      ///< Durations of `allocate` calls.
+    LatencyHistogram deallocate;    ///< Durations of `deallocate` calls.
+} LatencyHistograms;
+
+/**
+ * @brief Percentiles of a latency histogram, in timestamp ticks.
+ */
+typedef struct {
+    uint64_t count; ///< Number of recorded durations.
+    uint64_t sum;   ///< Sum of the recorded durations.
+    uint64_t p50;   ///< Median duration.
+    uint64_t p99;   ///< 99th percentile duration.
+    uint64_t p999;  ///< 99.9th percentile duration.
+} LatencySummary;
+#endif
+
+#ifdef SEARCH_COUNTERS
+/**
+ * @brief Work done by the allocator's bitmap searches, accumulated since initialization.
+ */
+typedef struct {
+    uint64_t searches;          ///< Number of free block searches started by the allocation functions.
+    uint64_t words_visited;     ///< Bitmap words the searches read from.
+    uint64_t bits_examined;     ///< Bits the searches tested.
+    uint64_t restarts;          ///< Times a partial match was abandoned at a used block.
+    uint64_t failed_searches;   ///< Searches that found no suitable sequence.
+    uint64_t run_words_visited; ///< Bitmap words read to find the end of allocations, e.g. by `deallocate`.
+} SearchCounters;
+#endif
+
+/**
+ * @brief Operations recorded in an allocation trace.
+ *
+ * @note
+ * The record types are declared in every build, so tools can read traces without `ALLOCATION_TRACE`.
+ */
+typedef enum {
+    TRACE_ALLOCATE = 1,     ///< A successful allocation; `size` is the requested size.
+    TRACE_DEALLOCATE = 2,   ///< A successful deallocation; `size` is the size of the allocation.
+    TRACE_FAILED = 3,       ///< An allocation that returned NULL; `index` is `INDEXSIZE_MAX`.
+} TraceOp;
+
+/**
+ * @brief One allocator call in an allocation trace, packed into 16 bytes.
+ */
+typedef struct {
+    uint64_t time_op;   ///< Timestamp in the upper 56 bits and the `TraceOp` in the lower 8.
+    uint32_t index;     ///< Index of the allocation's head block.
+    uint32_t size;      ///< Size in bytes, see `TraceOp`.
+} TraceRecord;
+
+#define TRACE_RECORD_OP(record) ((TraceOp)((record)->time_op & 0xFF))
+#define TRACE_RECORD_TIME(record) ((record)->time_op >> 8)
+
+#ifdef ALLOCATION_TRACE
+/**
+ * @brief Ring buffer receiving an allocator's trace.
+ */
+typedef struct {
+    TraceRecord* records;   ///< Buffer of `capacity` records, or NULL if tracing is off.
+    uint64_t capacity;      ///< Number of records the buffer holds.
+    uint64_t written;       ///< Number of records written since the buffer was set; record `i` is at `i % capacity`.
+} AllocationTrace;
+#endif
+
+#ifdef HEAP_PROFILE
+/**
+ * @brief A live allocation recorded by the heap profile.
+ */
+typedef struct {
+    void* callsite;     ///< Return address of the allocating call, or NULL for an unused slot.
+    indexSize_t index;  ///< Index of the allocation's head block.
+    indexSize_t size;   ///< Size that was requested, in bytes.
+} HeapSample;
+
+/**
+ * @brief Sampling state and live samples of an allocator.
+ */
+typedef struct {
+    uint64_t interval;  ///< Mean number of bytes allocated between samples, or 0 if sampling is off.
+    int64_t countdown;  ///< Bytes left to allocate before the next sample.
+    uint32_t seed;      ///< State of the generator that spreads the sample points.
+    uint64_t dropped;   ///< Samples lost because every slot was in use.
+    HeapSample samples[HEAP_PROFILE_SLOTS]; ///< Live sampled allocations.
+} HeapProfile;
+
+/**
+ * @brief Live sampled allocations of one call site.
+ */
+typedef struct {
+    void* callsite;             ///< Return address of the allocating call.
+    indexSize_t samples;        ///< Number of live sampled allocations.
+    uint64_t sampled_bytes;     ///< Requested bytes of the sampled allocations.
+    uint64_t estimated_bytes;   ///< Estimate of the live bytes allocated from the call site.
+} CallsiteProfile;
+#endif
+
 /**
  * @brief Represents an allocator with bitmaps and a memory block.
  */
@@ -49,6 +319,22 @@ typedef struct {
     BitMaps bitmaps;        ///< Bitmaps for managing memory allocation.
     MemoryBlock memory;     ///< The memory block being managed.
     indexSize_t block_size; ///< Size of each memory block.
+    AllocatorStats stats;   ///< Usage counters of the pool.
+#ifdef SEARCH_COUNTERS
+    SearchCounters search;  ///< Work done by the bitmap searches.
+#endif
+#ifdef SIZE_ACCOUNTING
+    SizeAccounting sizes;   ///< Requested and granted bytes of all allocations.
+#endif
+#ifdef HEAP_PROFILE
+    HeapProfile profile;    ///< Sampled live allocations.
+#endif
+#ifdef ALLOCATION_TRACE
+    AllocationTrace trace;  ///< Ring buffer receiving the trace.
+#endif
+#ifdef DIRTY_MAP
+    indexSize_t scrub_index; ///< Block index where `scrubFreeBlocks` resumes.
+#endif
 } Allocator;
 
 /* -- Function Declarations ----------------------------------------------- */
@@ -66,6 +352,50 @@ typedef struct {
  */
 void initAllocator(Allocator* allocator, indexSize_t block_size, void* memory, indexSize_t size);
 
+/**
+ * @brief Initializes an allocator whose block portion starts on an `alignment` boundary.
+ * 
+ * @param allocator The allocator to initialize.
+ * @param block_size The size of each block.
+ * @param memory The memory region to manage.
+ * @param size The size of the memory region.
+ * @param alignment The address alignment of the first block, e.g. 64 for a cache line or 4096 for a page.
+ * @return The number of bytes of `memory` that cannot hold blocks (bitmaps, alignment padding and
+ *         the unused tail), so callers can weigh density against alignment.
+ * 
+ * @note
+ * The provided `memory` MUST point to a block of free, zero-initialized memory of size `size`.
+ * Every block boundary is aligned when `block_size` is a multiple of `alignment`; otherwise only the
+ * first block is, and `allocateAligned` can be used for individual allocations.
+ */
+indexSize_t initAllocatorAligned(Allocator* allocator, indexSize_t block_size, void* memory, indexSize_t size, indexSize_t alignment);
+
+/**
+ * @brief Calculates the metadata size needed to manage a memory region with `initAllocatorExternal`.
+ * 
+ * @param block_size The size of each block.
+ * @param size The size of the memory region.
+ * @return The size of the metadata region in bytes.
+ */
+indexSize_t allocatorMetadataSize(indexSize_t block_size, indexSize_t size);
+
+/**
+ * @brief Initializes an allocator whose bitmaps live outside the managed memory region.
+ * 
+ * @param allocator The allocator to initialize.
+ * @param block_size The size of each block.
+ * @param metadata The region holding the bitmaps.
+ * @param metadata_size The size of the metadata region.
+ * @param memory The memory region to manage.
+ * @param size The size of the memory region.
+ * 
+ * @note
+ * The provided `metadata` MUST point to a block of free, zero-initialized memory of size `metadata_size`.
+ * The whole of `memory` is used for blocks; if `metadata_size` is smaller than `allocatorMetadataSize`
+ * reports, the pool is truncated to the blocks the metadata can track.
+ */
+void initAllocatorExternal(Allocator* allocator, indexSize_t block_size, void* metadata, indexSize_t metadata_size, void* memory, indexSize_t size);
+
 /**
  * @brief Allocates a block of memory from the allocator.
  * 
@@ -75,6 +405,30 @@ void initAllocator(Allocator* allocator, indexSize_t block_size, void* memory, i
  */
 void* allocate(Allocator* allocator, indexSize_t size);
 
+/**
+ * @brief Allocates a zero-filled block of memory from the allocator.
+ * 
+ * @param allocator The allocator to use for allocation.
+ * @param size The size of the memory block to allocate in bytes.
+ * @return A pointer to the allocated memory block, or NULL if the space is unavailable.
+ * 
+ * @note
+ * With `DIRTY_MAP` defined, only blocks that have been handed out since initialization
+ * (and not scrubbed since) are cleared. Otherwise the whole allocation is cleared.
+ */
+void* allocateZeroed(Allocator* allocator, indexSize_t size);
+
+/**
+ * @brief Allocates a block of memory whose address is a multiple of `alignment`.
+ * 
+ * @param allocator The allocator to use for allocation.
+ * @param size The size of the memory block to allocate in bytes.
+ * @param alignment The required address alignment in bytes. Must be a power of two.
+ * @return A pointer to the allocated memory block, or NULL if the space is unavailable
+ *         or no block in the pool can satisfy the alignment.
+ */
+void* allocateAligned(Allocator* allocator, indexSize_t size, indexSize_t alignment);
+
 /**
  * @brief Deallocates a previously allocated block of memory from the allocator.
  *
@@ -85,4 +439,235 @@ void* allocate(Allocator* allocator, indexSize_t size);
  */
 bool deallocate(Allocator* allocator, void* ptr);
 
+/**
+ * @brief Deallocates a previously allocated block of memory whose size is known to the caller.
+ *
+ * @param allocator The allocator to use for deallocation.
+ * @param ptr A pointer to the start of the block of memory to be deallocated.
+ * @param size The size that was requested when the block was allocated.
+ *
+ * @return true if the block was successfully deallocated, false otherwise.
+ *
+ * @note
+ * Only the head of the allocation and the block right after it are checked, so the cost does not
+ * depend on the allocation's length. A `size` that rounds to a different number of blocks than the
+ * allocation is rejected when the block after the span is still part of the allocation; passing a
+ * size larger than the allocation is undefined, as with sized delete in C++. With `RUN_LENGTHS`
+ * defined, any mismatch is rejected.
+ */
+bool deallocateSized(Allocator* allocator, void* ptr, indexSize_t size);
+
+/**
+ * @brief Gets the size of a previously allocated block of memory.
+ *
+ * @param allocator The allocator the block was allocated from.
+ * @param ptr A pointer to the start of the allocated block of memory.
+ *
+ * @return The size of the allocation in bytes, rounded up to a multiple of the block size,
+ *         or 0 if `ptr` is not the start of an allocation.
+ */
+indexSize_t allocationSize(Allocator* allocator, void* ptr);
+
+/**
+ * @brief Gets the usage counters of an allocator.
+ *
+ * @param allocator The allocator to inspect.
+ *
+ * @return A copy of the allocator's counters.
+ *
+ * @note
+ * The counters are updated as blocks are allocated and deallocated, so this does not scan the
+ * bitmaps and its cost does not depend on the size of the pool.
+ */
+AllocatorStats getAllocatorStats(Allocator* allocator);
+
+/**
+ * @brief Measures how the free blocks of an allocator are split into runs.
+ *
+ * @param allocator The allocator to inspect.
+ *
+ * @return The free run counts, the largest free run, the run length histogram and the
+ *         external fragmentation ratio.
+ *
+ * @note
+ * The `used` bitmap is scanned a word at a time, so the cost grows with the number of bitmap words
+ * plus the number of free runs. The allocator is not thread-safe; the caller must serialize this
+ * with `allocate`/`deallocate`.
+ */
+FragmentationStats getFragmentationStats(Allocator* allocator);
+
+/**
+ * @brief Writes a snapshot of an allocator's parameters and bitmaps, e.g. to save it to a file.
+ *
+ * @param allocator The allocator to inspect.
+ * @param buffer Receives an `AllocatorDumpHeader` followed by the packed `used` and `heads` bitmaps.
+ * @param capacity The number of bytes `buffer` can hold.
+ *
+ * @return The size of the snapshot in bytes. Nothing is written if it is larger than `capacity`,
+ *         so a call with a `capacity` of 0 gets the size to reserve.
+ *
+ * @note
+ * The snapshot holds no pointers and is written in host byte order. The allocator is not
+ * thread-safe; the caller must serialize this with `allocate`/`deallocate`.
+ */
+size_t dumpAllocator(Allocator* allocator, void* buffer, size_t capacity);
+
+/**
+ * @brief Renders an allocator's statistics as text for a monitoring system.
+ *
+ * @param allocator The allocator to inspect.
+ * @param format The format to render.
+ * @param buffer Receives the text, terminated like `snprintf` does. May be NULL if `capacity` is 0.
+ * @param capacity The number of bytes `buffer` can hold.
+ *
+ * @return The length of the full text, without the terminator. The text was cut short if this is
+ *         `capacity` or more.
+ *
+ * @note
+ * The text holds the usage counters and the free runs from `getFragmentationStats`, plus the search
+ * counters, size accounting and latency percentiles of the builds that keep them. Latency covers the
+ * calling thread, so a monitoring thread should first merge the other threads' histograms into its
+ * own with `mergeLatency`. Nothing is allocated, but the free runs cost a scan of the `used` bitmap,
+ * and the caller must serialize this with `allocate`/`deallocate`.
+ */
+size_t exportAllocatorStats(Allocator* allocator, StatsFormat format, char* buffer, size_t capacity);
+
+#ifdef LATENCY_HISTOGRAMS
+/**
+ * @brief Gets the latency histograms of the calling thread.
+ *
+ * @return The calling thread's histograms, covering every allocator it has used.
+ *
+ * @note
+ * Durations are measured with the time stamp counter on x86 (reference cycles), the virtual counter
+ * on AArch64, and in nanoseconds elsewhere. The histograms are written without synchronization, so
+ * other threads should only read them once the owning thread has handed them over, e.g. by merging
+ * them into a shared histogram under a lock.
+ */
+LatencyHistograms* getThreadLatency(void);
+
+/**
+ * @brief Records a duration in a latency histogram.
+ *
+ * @param histogram The histogram to update.
+ * @param ticks The duration in timestamp ticks.
+ */
+void recordLatency(LatencyHistogram* histogram, uint64_t ticks);
+
+/**
+ * @brief Adds the durations of one latency histogram to another.
+ *
+ * @param into The histogram to update.
+ * @param from The histogram to add.
+ */
+void mergeLatency(LatencyHistogram* into, const LatencyHistogram* from);
+
+/**
+ * @brief Gets a percentile of a latency histogram.
+ *
+ * @param histogram The histogram to query.
+ * @param per_mille The percentile in tenths of a percent, e.g. 500 for the median or 999 for p99.9.
+ *
+ * @return The upper bound of the bucket holding the percentile, or 0 if the histogram is empty.
+ */
+uint64_t latencyPercentile(const LatencyHistogram* histogram, uint32_t per_mille);
+
+/**
+ * @brief Summarizes a latency histogram with its p50, p99 and p99.9.
+ *
+ * @param histogram The histogram to summarize.
+ *
+ * @return The number of durations and their percentiles.
+ */
+LatencySummary summarizeLatency(const LatencyHistogram* histogram);
+#endif
+
+#ifdef SEARCH_COUNTERS
+/**
+ * @brief Gets the work done by the allocator's bitmap searches since initialization.
+ *
+ * @param allocator The allocator to inspect.
+ *
+ * @return A copy of the allocator's search counters.
+ */
+SearchCounters getSearchCounters(Allocator* allocator);
+#endif
+
+#ifdef SIZE_ACCOUNTING
+/**
+ * @brief Gets the requested and granted bytes of every allocation since initialization.
+ *
+ * @param allocator The allocator to inspect.
+ *
+ * @return The allocator's accounting, which stays valid and current for the allocator's lifetime.
+ *
+ * @note
+ * The waste of a bucket is `granted_bytes - requested_bytes`. Deallocations do not change the
+ * accounting, as the requested size of an allocation is not kept.
+ */
+const SizeAccounting* getSizeAccounting(Allocator* allocator);
+#endif
+
+#ifdef ALLOCATION_TRACE
+/**
+ * @brief Starts recording an allocator's calls into a ring buffer.
+ *
+ * @param allocator The allocator to trace.
+ * @param records The buffer to write records to, or NULL to stop tracing.
+ * @param capacity The number of records the buffer holds.
+ *
+ * @note
+ * Once the buffer is full, the oldest records are overwritten; `trace.written` tells how many were
+ * lost. Timestamps come from the same counter as `LATENCY_HISTOGRAMS`. The buffer is written without
+ * synchronization, so it should be read while the allocator is not in use.
+ */
+void setTraceBuffer(Allocator* allocator, TraceRecord* records, uint64_t capacity);
+#endif
+
+#ifdef HEAP_PROFILE
+/**
+ * @brief Sets how often the heap profile samples allocations.
+ *
+ * @param allocator The allocator to profile.
+ * @param interval The mean number of bytes allocated between samples, or 0 to stop sampling.
+ *
+ * @note
+ * Sample points are spread at random around the interval, so periodic allocation patterns are not
+ * over- or under-sampled. Allocations that are already sampled stay in the profile until deallocated.
+ */
+void setHeapProfileInterval(Allocator* allocator, uint64_t interval);
+
+/**
+ * @brief Groups the live sampled allocations by call site.
+ *
+ * @param allocator The allocator to inspect.
+ * @param callsites Receives one entry per call site, largest estimate first.
+ * @param capacity The number of entries `callsites` can hold.
+ *
+ * @return The number of entries written.
+ *
+ * @note
+ * Each sample stands for about `interval` allocated bytes, or its own size if larger, which gives
+ * `estimated_bytes`. Call sites are return addresses; resolve them with the symbol tools of the
+ * platform, e.g. `addr2line` or `dladdr`. Call sites beyond `capacity` are left out.
+ */
+indexSize_t dumpHeapProfile(Allocator* allocator, CallsiteProfile* callsites, indexSize_t capacity);
+#endif
+
+#ifdef DIRTY_MAP
+/**
+ * @brief Clears free blocks that hold stale data, so later zeroed allocations can skip them.
+ * 
+ * @param allocator The allocator to scrub.
+ * @param max_blocks The maximum number of blocks to clear in this call.
+ * @return The number of blocks that were cleared.
+ * 
+ * @note
+ * Intended to be called from an idle or background routine. Each call resumes where the
+ * previous one stopped, so the pool can be scrubbed incrementally. The allocator is not
+ * thread-safe; the caller must serialize this with `allocate`/`deallocate`.
+ */
+indexSize_t scrubFreeBlocks(Allocator* allocator, indexSize_t max_blocks);
+#endif
+
 #endif // _ALLOCATOR_H_
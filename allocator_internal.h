@@ -0,0 +1,129 @@
+#ifndef _ALLOCATOR_INTERNAL_H_
+#define _ALLOCATOR_INTERNAL_H_
+
+/*
+ * Bitmap primitives and block operations of `allocator.c`. They are not part of the public API; the
+ * benchmarks include this header to time and drive them directly.
+ */
+
+#include "allocator.h"
+
+/**
+ * @brief Sets the indexed bit to true.
+ * 
+ * @param bitmap The bitmap to be modified
+ * @param index The index of the bit to be enabled
+ */
+void setBit(mapSize_t* bitmap, indexSize_t index);
+
+/**
+ * @brief Sets the indexed bit to false.
+ * 
+ * @param bitmap The bitmap to be modified
+ * @param index The index of the bit to be disabled
+ */
+void clearBit(mapSize_t* bitmap, indexSize_t index);
+
+/**
+ * @brief Get the value of the indexed bit.
+ * 
+ * @param bitmap The bitmap to be sampled
+ * @param index The index of the bit to be sampled
+ */
+bool getBit(mapSize_t* bitmap, indexSize_t index);
+
+/**
+ * @brief Sets a range of bits to true, a word at a time.
+ * 
+ * @param bitmap The bitmap to be modified
+ * @param index The index of the first bit to be enabled
+ * @param count The number of bits to be enabled
+ */
+void setBits(mapSize_t* bitmap, indexSize_t index, indexSize_t count);
+
+/**
+ * @brief Sets a range of bits to false, a word at a time.
+ * 
+ * @param bitmap The bitmap to be modified
+ * @param index The index of the first bit to be disabled
+ * @param count The number of bits to be disabled
+ */
+void clearBits(mapSize_t* bitmap, indexSize_t index, indexSize_t count);
+
+/**
+ * @brief Finds a contiguous sequence of free blocks.
+ *
+ * @details
+ * This function takes a bitmap representing used blocks, the size of the bitmap, and the number of contiguous blocks needed.
+ * It iterates through each bit in the bitmap, keeping track of the count of consecutive free blocks.
+ * When it finds a sequence of `num_blocks` consecutive free blocks, it returns the index of the first block in the sequence.
+ * If it reaches the end of the bitmap without finding a suitable sequence, it returns INDEXSIZE_MAX.
+ *
+ * @param allocator The allocator whose `used` bitmap is searched
+ * @param num_blocks The number of contiguous blocks needed
+ * @return The index of the first block in the contiguous sequence if found, or INDEXSIZE_MAX if not found
+ */
+indexSize_t findContiguousFreeBlocks(Allocator* allocator, indexSize_t num_blocks);
+
+/**
+ * @brief Finds a contiguous sequence of free blocks starting on a strided set of indices.
+ *
+ * @details
+ * Only the indices `first`, `first + stride`, `first + 2 * stride`, ... are considered as the start
+ * of the sequence. Each candidate is checked from its last block backwards; the first used block
+ * found rules out every candidate up to and including it, so the scan skips directly past it.
+ *
+ * @param allocator The allocator whose `used` bitmap is searched
+ * @param num_blocks The number of contiguous blocks needed
+ * @param first The first candidate index
+ * @param stride The distance between candidate indices
+ * @return The index of the first block in the contiguous sequence if found, or INDEXSIZE_MAX if not found
+ */
+indexSize_t findStridedFreeBlocks(Allocator* allocator, indexSize_t num_blocks, indexSize_t first, indexSize_t stride);
+
+/**
+ * @brief Marks a sequence of blocks as an allocation.
+ * 
+ * @param allocator The allocator that owns the blocks
+ * @param start_index The index of the first block of the allocation
+ * @param num_blocks The number of blocks in the allocation
+ * @param size The size that was requested, in bytes
+ */
+void markAllocated(Allocator* allocator, indexSize_t start_index, indexSize_t num_blocks, indexSize_t size);
+
+/**
+ * @brief Marks an allocation's blocks as free.
+ * 
+ * @param allocator The allocator that owns the blocks
+ * @param start_index The index of the allocation's head block
+ * @param num_blocks The number of blocks in the allocation
+ */
+void markFreed(Allocator* allocator, indexSize_t start_index, indexSize_t num_blocks);
+
+/**
+ * @brief Counts the blocks in an allocation.
+ *
+ * @details
+ * The allocation ends at the first following block that is either free or the head of another
+ * allocation. Both maps are combined a word at a time, so the cost is one step per bitmap word
+ * the allocation spans rather than one per block. With `RUN_LENGTHS` defined, the length is read
+ * from the side table instead: from the head's entry, or, if that holds `RUN_LENGTH_MAX`, from the
+ * `sizeof(indexSize_t)` entries after it.
+ *
+ * @param allocator The allocator that owns the allocation
+ * @param index The index of the allocation's head block
+ * @return The number of blocks in the allocation
+ */
+indexSize_t runLength(Allocator* allocator, indexSize_t index);
+
+/**
+ * @brief Finds the block index of an allocation from a pointer.
+ *
+ * @param allocator The allocator the pointer belongs to
+ * @param ptr The pointer to be resolved
+ * @param index Receives the index of the allocation's head block
+ * @return true if `ptr` is the start of a block whose heads bit is set, false otherwise
+ */
+bool findHead(Allocator* allocator, void* ptr, indexSize_t* index);
+
+#endif // _ALLOCATOR_INTERNAL_H_
@@ -0,0 +1,177 @@
+/**
+ * @file bench_aging.c
+ *
+ * @brief Time series of allocator cost and fragmentation as a pool ages under a long workload.
+ *
+ * @details
+ * A preset workload from `workload.h` runs for millions of operations on one pool, which is never
+ * reset. After every interval of operations, one row reports the interval's throughput and the
+ * state of the pool at its end:
+ *
+ * - words/alloc: Bitmap words visited per `allocate` during the interval, from `SEARCH_COUNTERS`,
+ *   which this benchmark is always built with.
+ * - restarts/alloc: Candidate runs abandoned per `allocate` during the interval.
+ * - largest run: The largest free run in blocks, from `getFragmentationStats`.
+ * - ext frag: The external fragmentation of the free blocks.
+ * - fail %: The share of the interval's allocations that returned NULL.
+ *
+ * The workload is generated in chunks outside the timed region. The default pool is small enough
+ * that the presets keep it busy; pass `--csv` for output that is easy to plot.
+ *
+ * Usage: bench_aging.bench [--header] [--csv] [--workload NAME] [--ops N] [--interval N]
+ *                          [--block-size B] [--pool-bytes P] [--seed S]
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "bench_utils.h"
+#include "workload.h"
+
+/* -- Defines -------------------------------------------------------------*/
+
+#define DEFAULT_WORKLOAD "lognorm-bimodal"
+#define DEFAULT_OPS 5000000
+#define DEFAULT_INTERVAL 100000
+#define DEFAULT_BLOCK_SIZE 16
+#define DEFAULT_POOL_SIZE 65536
+#define DEFAULT_SEED 0x9E3779B97F4A7C15ull
+
+#ifndef SEARCH_COUNTERS
+#error "bench_aging needs SEARCH_COUNTERS"
+#endif
+
+typedef struct {
+    uint64_t ops;               ///< Operations run since the start.
+    double mops;                ///< Millions of calls per second during the interval.
+    double words_per_alloc;     ///< Bitmap words visited per allocation during the interval.
+    double restarts_per_alloc;  ///< Abandoned candidate runs per allocation during the interval.
+    indexSize_t live;           ///< Live allocations at the end of the interval.
+    double used;                ///< Share of the pool allocated at the end of the interval.
+    indexSize_t largest_run;    ///< Largest free run at the end of the interval, in blocks.
+    float external;             ///< External fragmentation at the end of the interval.
+    double failure_rate;        ///< Share of the interval's allocations that failed.
+} Sample;
+
+/* -- Main ----------------------------------------------------------------*/
+
+static void printSample(const Sample* sample, bool csv) {
+    if (csv) {
+        printf("%s,%llu,%.3f,%.2f,%.3f,%llu,%.4f,%llu,%.4f,%.4f\n", BENCH_CONFIG, (unsigned long long)sample->ops,
+               sample->mops, sample->words_per_alloc, sample->restarts_per_alloc, (unsigned long long)sample->live,
+               sample->used, (unsigned long long)sample->largest_run, sample->external, sample->failure_rate);
+        return;
+    }
+    printf("%-14s %10llu %8.2f %11.2f %14.3f %6llu %6.1f%% %11llu %8.3f %7.2f%%\n", BENCH_CONFIG,
+           (unsigned long long)sample->ops, sample->mops, sample->words_per_alloc, sample->restarts_per_alloc,
+           (unsigned long long)sample->live, 100.0 * sample->used, (unsigned long long)sample->largest_run,
+           sample->external, 100.0 * sample->failure_rate);
+}
+
+int main(int argc, char** argv) {
+    bool header = false;
+    bool csv = false;
+    const char* name = DEFAULT_WORKLOAD;
+    uint64_t ops = DEFAULT_OPS;
+    uint64_t interval = DEFAULT_INTERVAL;
+    uint64_t block_size = DEFAULT_BLOCK_SIZE;
+    uint64_t pool_size = DEFAULT_POOL_SIZE;
+    uint64_t seed = DEFAULT_SEED;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--header") == 0) header = true;
+        else if (strcmp(argv[i], "--csv") == 0) csv = true;
+        else if (strcmp(argv[i], "--workload") == 0 && i + 1 < argc) name = argv[++i];
+        else if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc) ops = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) interval = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--block-size") == 0 && i + 1 < argc) block_size = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--pool-bytes") == 0 && i + 1 < argc) pool_size = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 0);
+        else {
+            fprintf(stderr, "usage: %s [--header] [--csv] [--workload NAME] [--ops N] [--interval N] "
+                            "[--block-size B] [--pool-bytes P] [--seed S]\n", argv[0]);
+            return 2;
+        }
+    }
+    const WorkloadConfig* config = workloadFind(name);
+    if (config == NULL) {
+        fprintf(stderr, "unknown workload %s; presets are:", name);
+        for (size_t i = 0; i < workload_preset_count; i++) fprintf(stderr, " %s", workload_presets[i].name);
+        fprintf(stderr, "\n");
+        return 2;
+    }
+    if (ops == 0 || interval == 0 || block_size == 0 || seed == 0) {
+        fprintf(stderr, "ops, interval, block size and seed must be non-zero\n");
+        return 2;
+    }
+    // Shrink the pool to what the index type can address
+    if (pool_size > INDEXSIZE_MAX) pool_size = INDEXSIZE_MAX / block_size * block_size;
+    if (pool_size < block_size) {
+        fprintf(stderr, "the pool must hold at least one block\n");
+        return 2;
+    }
+
+    Workload workload;
+    Allocator allocator;
+    indexSize_t metadata_size = allocatorMetadataSize((indexSize_t)block_size, (indexSize_t)pool_size);
+    void* metadata = calloc(1, metadata_size);
+    void* memory = calloc(1, pool_size);
+    void** slots = calloc(config->max_live, sizeof(void*));
+    WorkloadOp* chunk = malloc(interval * sizeof(WorkloadOp));
+    if (!metadata || !memory || !slots || !chunk || !workloadInit(&workload, config, seed)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    initAllocatorExternal(&allocator, (indexSize_t)block_size, metadata, metadata_size, memory, (indexSize_t)pool_size);
+
+    if (header && csv) {
+        printf("config,ops,mops,words_per_alloc,restarts_per_alloc,live,used,largest_run,external_fragmentation,failure_rate\n");
+    } else if (header) {
+        printf("%-14s %10s %8s %11s %14s %6s %7s %11s %8s %8s\n",
+               "config", "ops", "Mops/s", "words/alloc", "restarts/alloc", "live", "used", "largest run", "ext frag", "fail");
+    }
+    for (uint64_t done = 0; done < ops; done += interval) {
+        uint64_t count = (ops - done < interval) ? ops - done : interval;
+        for (uint64_t i = 0; i < count; i++) workloadNext(&workload, &chunk[i]);
+
+        SearchCounters before = getSearchCounters(&allocator);
+        uint64_t allocations = 0;
+        uint64_t failures = 0;
+        uint64_t start = benchNow();
+        for (uint64_t i = 0; i < count; i++) {
+            const WorkloadOp* op = &chunk[i];
+            if (op->kind == WORKLOAD_ALLOCATE) {
+                slots[op->slot] = allocate(&allocator, (indexSize_t)op->size);
+                allocations++;
+                if (slots[op->slot] == NULL) failures++;
+            } else if (slots[op->slot] != NULL) {
+                deallocate(&allocator, slots[op->slot]);
+                slots[op->slot] = NULL;
+            }
+        }
+        uint64_t elapsed = benchNow() - start;
+        SearchCounters after = getSearchCounters(&allocator);
+        FragmentationStats fragmentation = getFragmentationStats(&allocator);
+        AllocatorStats stats = getAllocatorStats(&allocator);
+
+        Sample sample = {
+            .ops = done + count,
+            .mops = elapsed ? (count * 1000.0) / (double)elapsed : 0.0,
+            .words_per_alloc = allocations ? (double)(after.words_visited - before.words_visited) / allocations : 0.0,
+            .restarts_per_alloc = allocations ? (double)(after.restarts - before.restarts) / allocations : 0.0,
+            .live = stats.live_allocations,
+            .used = (double)stats.allocated_blocks / (stats.allocated_blocks + stats.free_blocks),
+            .largest_run = fragmentation.largest_free_run,
+            .external = fragmentation.external_fragmentation,
+            .failure_rate = allocations ? (double)failures / allocations : 0.0,
+        };
+        printSample(&sample, csv);
+        fflush(stdout);
+    }
+
+    workloadFree(&workload);
+    free(chunk);
+    free(slots);
+    free(metadata);
+    free(memory);
+    return 0;
+}
@@ -0,0 +1,375 @@
+/**
+ * @file bench_allocator.c
+ *
+ * @brief Throughput and latency of `allocate`/`deallocate` for common allocation patterns.
+ *
+ * @details
+ * Each pattern keeps a fixed set of live allocations in the pool. After the set is filled, every
+ * step deallocates one allocation, chosen by the pattern's free order, and allocates a replacement
+ * of a size drawn from the pattern's range. Every pattern runs twice per pool size: once untimed
+ * per call to measure throughput, and once timing each call to measure latency. The latency
+ * figures include the cost of reading the clock.
+ *
+ * The live set covers a quarter of the pool, so larger pools hold proportionally more live
+ * allocations. The free block search scans from the first block on every call, so filling the set
+ * through `allocate` would take time quadratic in its size; it is filled instead by placing
+ * allocations back to back with `markAllocated` from `allocator_internal.h`, exactly where first fit
+ * puts them in an empty pool. The steady-state cost follows the occupied prefix. Pools that do not fit `indexSize_t`, or that exceed `--max-blocks`, are skipped.
+ *
+ * With `--counters`, hardware counters from `bench_counters.h` are read around the throughput run
+ * and reported per call. With `--repeat N`, every run is repeated and the table shows the medians,
+ * counters included.
+ * With `--json`, the results of every repetition are printed as one JSON document instead, which
+ * `perf_gate` compares against a baseline.
+ *
+ * Usage: bench_allocator.bench [--header] [--json] [--repeat N] [--counters] [--ops N] [--block-size B] [--seed S]
+ *                              [--max-blocks N]
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "allocator_internal.h"
+#include "bench_counters.h"
+#include "bench_utils.h"
+
+/* -- Defines -------------------------------------------------------------*/
+
+#define DEFAULT_OPS 50000
+#define DEFAULT_BLOCK_SIZE 8
+#define DEFAULT_SEED 0x9E3779B97F4A7C15ull
+#define MAX_REPEAT 100
+
+typedef enum {
+    ORDER_FIFO,     ///< Deallocate the oldest allocation.
+    ORDER_LIFO,     ///< Deallocate the newest allocation.
+    ORDER_RANDOM,   ///< Deallocate any live allocation.
+} FreeOrder;
+
+typedef struct {
+    const char* name;       ///< Name printed in the results.
+    indexSize_t min_blocks; ///< Smallest allocation, in blocks.
+    indexSize_t max_blocks; ///< Largest allocation, in blocks.
+    FreeOrder order;        ///< Order in which allocations are deallocated.
+} Pattern;
+
+typedef struct {
+    double mops;        ///< Millions of `allocate` and `deallocate` calls per second.
+    uint64_t alloc_p50; ///< Median `allocate` latency in nanoseconds.
+    uint64_t alloc_p99; ///< 99th percentile `allocate` latency in nanoseconds.
+    uint64_t free_p50;  ///< Median `deallocate` latency in nanoseconds.
+    uint64_t free_p99;  ///< 99th percentile `deallocate` latency in nanoseconds.
+    uint64_t failures;  ///< Allocations that returned NULL.
+    double counters[COUNTER_COUNT]; ///< Hardware counter totals of the throughput run.
+} Result;
+
+static const Pattern patterns[] = {
+    { "fixed",  1, 1,  ORDER_FIFO },
+    { "mixed",  1, 16, ORDER_FIFO },
+    { "lifo",   1, 8,  ORDER_LIFO },
+    { "fifo",   1, 8,  ORDER_FIFO },
+    { "random", 1, 8,  ORDER_RANDOM },
+};
+
+static const uint64_t pool_sizes[] = { 1000, 10000, 100000, 1000000, 10000000 };
+
+/* -- Pattern Driver ------------------------------------------------------*/
+
+typedef struct {
+    Allocator allocator;
+    void* metadata;
+    void* memory;
+    void** live;            ///< Live allocations; a ring for FIFO, a stack for LIFO.
+    size_t head;            ///< Index of the oldest allocation in the ring.
+    size_t count;           ///< Number of live allocations.
+    size_t capacity;        ///< Size of the live set.
+    uint64_t seed;
+} Pool;
+
+/**
+ * @brief Creates a pool of exactly `blocks` blocks with external metadata, and room for a live set
+ * covering a quarter of it.
+ *
+ * @return true if the pool fits the index type and memory could be reserved.
+ */
+static bool poolInit(Pool* pool, const Pattern* pattern, uint64_t blocks, indexSize_t block_size) {
+    uint64_t size = blocks * block_size;
+    if (size > INDEXSIZE_MAX) return false;
+    uint64_t average = (pattern->min_blocks + pattern->max_blocks + 1) / 2;
+    pool->capacity = blocks / 4 / average;
+    if (pool->capacity < 1) pool->capacity = 1;
+    indexSize_t metadata_size = allocatorMetadataSize(block_size, (indexSize_t)size);
+    pool->metadata = calloc(1, metadata_size);
+    pool->memory = calloc(1, size);
+    pool->live = malloc(pool->capacity * sizeof(void*));
+    if (!pool->metadata || !pool->memory || !pool->live) {
+        free(pool->metadata);
+        free(pool->memory);
+        free(pool->live);
+        return false;
+    }
+    initAllocatorExternal(&pool->allocator, block_size, pool->metadata, metadata_size, pool->memory, (indexSize_t)size);
+    pool->head = 0;
+    pool->count = 0;
+    return true;
+}
+
+static void poolFree(Pool* pool) {
+    free(pool->metadata);
+    free(pool->memory);
+    free(pool->live);
+}
+
+/**
+ * @brief Removes the next allocation to free from the live set, according to the pattern.
+ */
+static void* takeVictim(Pool* pool, const Pattern* pattern) {
+    void* victim;
+    switch (pattern->order) {
+    case ORDER_LIFO:
+        pool->count--;
+        victim = pool->live[(pool->head + pool->count) % pool->capacity];
+        break;
+    case ORDER_RANDOM: {
+        size_t slot = (pool->head + benchRandom(&pool->seed) % pool->count) % pool->capacity;
+        victim = pool->live[slot];
+        // Fill the hole with the oldest allocation, so the live set stays a contiguous ring
+        pool->live[slot] = pool->live[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+        break;
+    }
+    default:
+        victim = pool->live[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+        break;
+    }
+    return victim;
+}
+
+static void pushLive(Pool* pool, void* block) {
+    pool->live[(pool->head + pool->count) % pool->capacity] = block;
+    pool->count++;
+}
+
+static indexSize_t drawSize(Pool* pool, const Pattern* pattern) {
+    return (indexSize_t)benchRange(&pool->seed, pattern->min_blocks, pattern->max_blocks) * pool->allocator.block_size;
+}
+
+/**
+ * @brief Fills the live set of an empty pool, leaving it at three quarters free or more.
+ */
+static void fillLive(Pool* pool, const Pattern* pattern) {
+    Allocator* allocator = &pool->allocator;
+    indexSize_t next = 0;
+    while (pool->count < pool->capacity) {
+        indexSize_t size = drawSize(pool, pattern);
+        indexSize_t num_blocks = size / allocator->block_size;
+        if (num_blocks > allocator->bitmaps.size - next) break;
+        markAllocated(allocator, next, num_blocks, size);
+        pushLive(pool, (uint8_t*)allocator->memory.head + (size_t)next * allocator->block_size);
+        next += num_blocks;
+    }
+}
+
+static void drainLive(Pool* pool) {
+    while (pool->count > 0) {
+        deallocate(&pool->allocator, pool->live[pool->head]);
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+    }
+}
+
+/**
+ * @brief Runs one pattern on one pool size.
+ *
+ * @return true if the pool could be created.
+ */
+static bool runPattern(const Pattern* pattern, uint64_t blocks, indexSize_t block_size, uint64_t ops, uint64_t seed, BenchCounters* counters, Result* result) {
+    Pool pool;
+    if (!poolInit(&pool, pattern, blocks, block_size)) return false;
+    memset(result, 0, sizeof(*result));
+    pool.seed = seed;
+
+    // Throughput: untimed calls
+    fillLive(&pool, pattern);
+    if (counters) benchCountersStart(counters);
+    uint64_t start = benchNow();
+    for (uint64_t op = 0; op < ops; op++) {
+        if (pool.count > 0) deallocate(&pool.allocator, takeVictim(&pool, pattern));
+        void* block = allocate(&pool.allocator, drawSize(&pool, pattern));
+        if (block) pushLive(&pool, block); else result->failures++;
+    }
+    uint64_t elapsed = benchNow() - start;
+    if (counters) {
+        benchCountersStop(counters);
+        memcpy(result->counters, counters->values, sizeof(result->counters));
+    }
+    result->mops = elapsed ? (2.0 * ops * 1000.0) / (double)elapsed : 0.0;
+    drainLive(&pool);
+
+    // Latency: every call timed
+    uint64_t* alloc_ns = malloc(ops * sizeof(uint64_t));
+    uint64_t* free_ns = malloc(ops * sizeof(uint64_t));
+    size_t frees = 0;
+    fillLive(&pool, pattern);
+    for (uint64_t op = 0; op < ops; op++) {
+        if (pool.count > 0) {
+            void* victim = takeVictim(&pool, pattern);
+            uint64_t before = benchNow();
+            deallocate(&pool.allocator, victim);
+            free_ns[frees++] = benchNow() - before;
+        }
+        indexSize_t size = drawSize(&pool, pattern);
+        uint64_t before = benchNow();
+        void* block = allocate(&pool.allocator, size);
+        alloc_ns[op] = benchNow() - before;
+        if (block) pushLive(&pool, block);
+    }
+    drainLive(&pool);
+    result->alloc_p50 = benchPercentile(alloc_ns, ops, 500);
+    result->alloc_p99 = benchPercentile(alloc_ns, ops, 990);
+    result->free_p50 = benchPercentile(free_ns, frees, 500);
+    result->free_p99 = benchPercentile(free_ns, frees, 990);
+
+    free(alloc_ns);
+    free(free_ns);
+    poolFree(&pool);
+    return true;
+}
+
+/* -- Output --------------------------------------------------------------*/
+
+/**
+ * @brief Gets the median of one field over repeated results.
+ */
+static double medianResult(const Result* results, size_t count, size_t offset, bool is_double) {
+    double values[MAX_REPEAT];
+    for (size_t i = 0; i < count; i++) {
+        const char* field = (const char*)&results[i] + offset;
+        values[i] = is_double ? *(const double*)field : (double)*(const uint64_t*)field;
+    }
+    return benchMedian(values, count);
+}
+
+#define MEDIAN_RESULT(results, count, field) \
+    medianResult((results), (count), offsetof(Result, field), _Generic(((Result*)0)->field, double: true, default: false))
+
+static void printJsonSeries(const char* key, const Result* results, size_t count, size_t offset, bool is_double, bool last) {
+    printf("\"%s\": [", key);
+    for (size_t i = 0; i < count; i++) {
+        const char* field = (const char*)&results[i] + offset;
+        if (is_double) printf("%s%.4f", i ? ", " : "", *(const double*)field);
+        else printf("%s%llu", i ? ", " : "", (unsigned long long)*(const uint64_t*)field);
+    }
+    printf("]%s", last ? "" : ", ");
+}
+
+#define PRINT_JSON_SERIES(key, results, count, field, last) \
+    printJsonSeries((key), (results), (count), offsetof(Result, field), _Generic(((Result*)0)->field, double: true, default: false), (last))
+
+/**
+ * @brief Prints the repeated results of one run as a JSON object.
+ */
+static void printJsonResult(const Pattern* pattern, uint64_t blocks, const Result* results, size_t count, bool first) {
+    printf("%s\n    { \"name\": \"%s/%llu\", ", first ? "" : ",", pattern->name, (unsigned long long)blocks);
+    PRINT_JSON_SERIES("mops", results, count, mops, false);
+    PRINT_JSON_SERIES("alloc_p50_ns", results, count, alloc_p50, false);
+    PRINT_JSON_SERIES("alloc_p99_ns", results, count, alloc_p99, false);
+    PRINT_JSON_SERIES("free_p50_ns", results, count, free_p50, false);
+    PRINT_JSON_SERIES("free_p99_ns", results, count, free_p99, false);
+    PRINT_JSON_SERIES("failures", results, count, failures, true);
+    printf(" }");
+}
+
+/* -- Main ----------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+    bool header = false;
+    bool json = false;
+    bool use_counters = false;
+    uint64_t repeat = 1;
+    uint64_t ops = DEFAULT_OPS;
+    uint64_t block_size = DEFAULT_BLOCK_SIZE;
+    uint64_t seed = DEFAULT_SEED;
+    uint64_t max_blocks = UINT64_MAX;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--header") == 0) header = true;
+        else if (strcmp(argv[i], "--json") == 0) json = true;
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeat = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--counters") == 0) use_counters = true;
+        else if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc) ops = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--block-size") == 0 && i + 1 < argc) block_size = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--max-blocks") == 0 && i + 1 < argc) max_blocks = strtoull(argv[++i], NULL, 0);
+        else {
+            fprintf(stderr, "usage: %s [--header] [--json] [--repeat N] [--counters] [--ops N] [--block-size B] [--seed S] "
+                            "[--max-blocks N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (ops == 0 || block_size == 0 || seed == 0) {
+        fprintf(stderr, "ops, block size and seed must be non-zero\n");
+        return 2;
+    }
+    if (repeat == 0 || repeat > MAX_REPEAT) {
+        fprintf(stderr, "repeat must be between 1 and %d\n", MAX_REPEAT);
+        return 2;
+    }
+
+    BenchCounters counters;
+    if (use_counters && benchCountersOpen(&counters) < COUNTER_COUNT) {
+        fprintf(stderr, "some hardware counters are unavailable and show as '-'\n");
+    }
+    if (json) {
+        printf("{\n  \"config\": \"%s\",\n  \"ops\": %llu,\n  \"block_size\": %llu,\n  \"seed\": %llu,\n  \"repeat\": %llu,\n  \"benchmarks\": [",
+               BENCH_CONFIG, (unsigned long long)ops, (unsigned long long)block_size, (unsigned long long)seed, (unsigned long long)repeat);
+    } else if (header) {
+        printf("%-14s %-7s %9s %9s %10s %10s %10s %10s %8s",
+               "config", "pattern", "blocks", "Mops/s", "alloc p50", "alloc p99", "free p50", "free p99", "failed");
+        if (use_counters) benchCountersPrintHeader();
+        printf("\n");
+    }
+    bool first = true;
+    for (size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); p++) {
+        for (size_t s = 0; s < sizeof(pool_sizes) / sizeof(pool_sizes[0]); s++) {
+            static Result results[MAX_REPEAT];
+            bool created = pool_sizes[s] <= max_blocks;
+            for (uint64_t r = 0; r < repeat && created; r++) {
+                created = runPattern(&patterns[p], pool_sizes[s], (indexSize_t)block_size, ops, seed, use_counters ? &counters : NULL, &results[r]);
+            }
+            if (json) {
+                if (created) printJsonResult(&patterns[p], pool_sizes[s], results, repeat, first);
+                first = first && !created;
+                fflush(stdout);
+                continue;
+            }
+            if (!created) {
+                printf("%-14s %-7s %9llu %9s\n", BENCH_CONFIG, patterns[p].name, (unsigned long long)pool_sizes[s], "skipped");
+                continue;
+            }
+            printf("%-14s %-7s %9llu %9.2f %8.0fns %8.0fns %8.0fns %8.0fns %8.0f",
+                   BENCH_CONFIG, patterns[p].name, (unsigned long long)pool_sizes[s], MEDIAN_RESULT(results, repeat, mops),
+                   MEDIAN_RESULT(results, repeat, alloc_p50), MEDIAN_RESULT(results, repeat, alloc_p99),
+                   MEDIAN_RESULT(results, repeat, free_p50), MEDIAN_RESULT(results, repeat, free_p99),
+                   MEDIAN_RESULT(results, repeat, failures));
+            // The throughput run makes a deallocation and an allocation per op
+            if (use_counters) {
+                BenchCounters medians = counters;
+                for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+                    double values[MAX_REPEAT];
+                    for (uint64_t r = 0; r < repeat; r++) values[r] = results[r].counters[counter];
+                    medians.values[counter] = benchMedian(values, repeat);
+                }
+                benchCountersPrint(&medians, 2 * ops);
+            }
+            printf("\n");
+            fflush(stdout);
+        }
+    }
+    if (json) printf("\n  ]\n}\n");
+    if (use_counters) benchCountersClose(&counters);
+    return 0;
+}
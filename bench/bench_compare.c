@@ -0,0 +1,348 @@
+/**
+ * @file bench_compare.c
+ *
+ * @brief Compares the allocator with glibc `malloc`/`free` and a naive intrusive free-list pool.
+ *
+ * @details
+ * Every preset workload from `workload.h` runs through each allocator in turn. The harness writes
+ * the first byte of every allocation, as a caller would. Each run happens in its own child process,
+ * so one allocator's pages cannot count towards another's resident set. A row reports:
+ *
+ * - Mops/s: Millions of allocation and deallocation calls per second, over the whole stream.
+ * - RSS: Growth of the resident set from before the allocator was set up to the end of the run, in KiB.
+ * - metadata: Bytes of bookkeeping outside the payload. For the bitmap allocator this is
+ *   `allocatorMetadataSize`. The free-list pool keeps its links inside free slots, so it only needs its
+ *   head. For `malloc` it is an estimate: one `size_t` chunk header for each allocation at the peak.
+ * - peak live: Most payload bytes requested and live at once.
+ * - failed: Allocations that returned NULL.
+ *
+ * The bitmap allocator and the free-list pool get the same pool size. The free-list pool has one slot
+ * size, the largest size of the workload, so it needs no size search but wastes the rest of each slot;
+ * it threads every slot at set-up, which touches the whole pool.
+ *
+ * Usage: bench_compare.bench [--header] [--ops N] [--block-size B] [--pool-bytes P] [--seed S]
+ */
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "allocator.h"
+#include "bench_utils.h"
+#include "workload.h"
+
+/* -- Defines -------------------------------------------------------------*/
+
+#define DEFAULT_OPS 1000000
+#define DEFAULT_BLOCK_SIZE 16
+#define DEFAULT_POOL_SIZE (1u << 22)
+#define DEFAULT_SEED 0x9E3779B97F4A7C15ull
+#define FREE_LIST_ALIGNMENT 16
+
+typedef struct Backend Backend;
+
+struct Backend {
+    const char* name;
+    bool (*init)(Backend* backend, indexSize_t block_size, indexSize_t pool_size, uint32_t max_size);
+    void* (*allocate)(Backend* backend, size_t size);
+    void (*deallocate)(Backend* backend, void* pointer);
+    size_t (*metadata)(Backend* backend, uint64_t peak_allocations);
+    void (*destroy)(Backend* backend);
+    void* state;
+};
+
+typedef struct {
+    double mops;                ///< Millions of calls per second.
+    uint64_t rss_kib;           ///< Growth of the resident set, in KiB.
+    uint64_t metadata_bytes;    ///< Bytes of bookkeeping outside the payload.
+    uint64_t peak_live_bytes;   ///< Most requested bytes live at once.
+    uint64_t failures;          ///< Allocations that returned NULL.
+} Result;
+
+/* -- Bitmap Allocator ----------------------------------------------------*/
+
+static void bitmapDestroy(Backend* backend);
+
+typedef struct {
+    Allocator allocator;
+    void* metadata;
+    void* memory;
+    indexSize_t metadata_size;
+} BitmapState;
+
+static bool bitmapInit(Backend* backend, indexSize_t block_size, indexSize_t pool_size, uint32_t max_size) {
+    (void)max_size;
+    BitmapState* state = calloc(1, sizeof(BitmapState));
+    if (state == NULL) return false;
+    state->metadata_size = allocatorMetadataSize(block_size, pool_size);
+    state->metadata = calloc(1, state->metadata_size);
+    state->memory = calloc(1, pool_size);
+    backend->state = state;
+    if (!state->metadata || !state->memory) {
+        bitmapDestroy(backend);
+        return false;
+    }
+    initAllocatorExternal(&state->allocator, block_size, state->metadata, state->metadata_size, state->memory, pool_size);
+    return true;
+}
+
+static void* bitmapAllocate(Backend* backend, size_t size) {
+    return allocate(&((BitmapState*)backend->state)->allocator, (indexSize_t)size);
+}
+
+static void bitmapDeallocate(Backend* backend, void* pointer) {
+    deallocate(&((BitmapState*)backend->state)->allocator, pointer);
+}
+
+static size_t bitmapMetadata(Backend* backend, uint64_t peak_allocations) {
+    (void)peak_allocations;
+    return ((BitmapState*)backend->state)->metadata_size;
+}
+
+static void bitmapDestroy(Backend* backend) {
+    BitmapState* state = backend->state;
+    free(state->metadata);
+    free(state->memory);
+    free(state);
+}
+
+/* -- glibc malloc --------------------------------------------------------*/
+
+static bool mallocInit(Backend* backend, indexSize_t block_size, indexSize_t pool_size, uint32_t max_size) {
+    (void)backend;
+    (void)block_size;
+    (void)pool_size;
+    (void)max_size;
+    return true;
+}
+
+static void* mallocAllocate(Backend* backend, size_t size) {
+    (void)backend;
+    return malloc(size);
+}
+
+static void mallocDeallocate(Backend* backend, void* pointer) {
+    (void)backend;
+    free(pointer);
+}
+
+static size_t mallocMetadata(Backend* backend, uint64_t peak_allocations) {
+    (void)backend;
+    return peak_allocations * sizeof(size_t);
+}
+
+static void mallocDestroy(Backend* backend) {
+    (void)backend;
+}
+
+/* -- Intrusive Free List -------------------------------------------------*/
+
+static void freeListDestroy(Backend* backend);
+
+typedef struct {
+    void* head;         ///< First free slot; each free slot starts with a pointer to the next.
+    size_t slot_size;   ///< Size of every slot, in bytes.
+    uint8_t* memory;
+} FreeListState;
+
+static bool freeListInit(Backend* backend, indexSize_t block_size, indexSize_t pool_size, uint32_t max_size) {
+    (void)block_size;
+    FreeListState* state = calloc(1, sizeof(FreeListState));
+    if (state == NULL) return false;
+    state->slot_size = (max_size + FREE_LIST_ALIGNMENT - 1) / FREE_LIST_ALIGNMENT * FREE_LIST_ALIGNMENT;
+    state->memory = malloc(pool_size);
+    backend->state = state;
+    if (state->memory == NULL) {
+        freeListDestroy(backend);
+        return false;
+    }
+    // Thread the slots from the last to the first, so the first slot is handed out first
+    size_t slots = pool_size / state->slot_size;
+    for (size_t slot = slots; slot > 0; slot--) {
+        void* pointer = state->memory + (slot - 1) * state->slot_size;
+        *(void**)pointer = state->head;
+        state->head = pointer;
+    }
+    return true;
+}
+
+static void* freeListAllocate(Backend* backend, size_t size) {
+    FreeListState* state = backend->state;
+    void* pointer = state->head;
+    if (size > state->slot_size || pointer == NULL) return NULL;
+    state->head = *(void**)pointer;
+    return pointer;
+}
+
+static void freeListDeallocate(Backend* backend, void* pointer) {
+    FreeListState* state = backend->state;
+    *(void**)pointer = state->head;
+    state->head = pointer;
+}
+
+static size_t freeListMetadata(Backend* backend, uint64_t peak_allocations) {
+    (void)backend;
+    (void)peak_allocations;
+    return sizeof(void*);
+}
+
+static void freeListDestroy(Backend* backend) {
+    FreeListState* state = backend->state;
+    free(state->memory);
+    free(state);
+}
+
+static const Backend backends[] = {
+    { "bitmap", bitmapInit, bitmapAllocate, bitmapDeallocate, bitmapMetadata, bitmapDestroy, NULL },
+    { "malloc", mallocInit, mallocAllocate, mallocDeallocate, mallocMetadata, mallocDestroy, NULL },
+    { "freelist", freeListInit, freeListAllocate, freeListDeallocate, freeListMetadata, freeListDestroy, NULL },
+};
+
+/* -- Driver --------------------------------------------------------------*/
+
+/**
+ * @brief Reads the resident set size of this process.
+ *
+ * @return The resident set size in bytes, or 0 if it cannot be read.
+ */
+static uint64_t residentBytes(void) {
+    unsigned long long size = 0;
+    unsigned long long resident = 0;
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file == NULL) return 0;
+    if (fscanf(file, "%llu %llu", &size, &resident) != 2) resident = 0;
+    fclose(file);
+    return resident * (uint64_t)sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * @brief Runs a generated workload through one allocator.
+ *
+ * @return true if the allocator could be set up.
+ */
+static bool runBackend(Backend* backend, const WorkloadConfig* config, const WorkloadOp* stream, uint64_t ops,
+                       indexSize_t block_size, indexSize_t pool_size, Result* result) {
+    void** slots = calloc(config->max_live, sizeof(void*));
+    uint32_t* sizes = calloc(config->max_live, sizeof(uint32_t));
+    if (!slots || !sizes) return false;
+    memset(result, 0, sizeof(*result));
+    uint64_t baseline = residentBytes();
+    if (!backend->init(backend, block_size, pool_size, config->max_size)) return false;
+
+    uint64_t live_bytes = 0;
+    uint64_t live_allocations = 0;
+    uint64_t peak_allocations = 0;
+    uint64_t start = benchNow();
+    for (uint64_t i = 0; i < ops; i++) {
+        const WorkloadOp* op = &stream[i];
+        if (op->kind == WORKLOAD_ALLOCATE) {
+            uint8_t* pointer = backend->allocate(backend, op->size);
+            slots[op->slot] = pointer;
+            if (pointer == NULL) {
+                result->failures++;
+                continue;
+            }
+            pointer[0] = (uint8_t)i;
+            sizes[op->slot] = op->size;
+            live_bytes += op->size;
+            if (live_bytes > result->peak_live_bytes) result->peak_live_bytes = live_bytes;
+            if (++live_allocations > peak_allocations) peak_allocations = live_allocations;
+        } else if (slots[op->slot] != NULL) {
+            backend->deallocate(backend, slots[op->slot]);
+            slots[op->slot] = NULL;
+            live_bytes -= sizes[op->slot];
+            live_allocations--;
+        }
+    }
+    uint64_t elapsed = benchNow() - start;
+    uint64_t resident = residentBytes();
+
+    result->mops = elapsed ? (ops * 1000.0) / (double)elapsed : 0.0;
+    result->rss_kib = (resident > baseline) ? (resident - baseline) / 1024 : 0;
+    result->metadata_bytes = backend->metadata(backend, peak_allocations);
+    for (uint32_t slot = 0; slot < config->max_live; slot++) {
+        if (slots[slot]) backend->deallocate(backend, slots[slot]);
+    }
+    backend->destroy(backend);
+    free(slots);
+    free(sizes);
+    return true;
+}
+
+/**
+ * @brief Generates a workload and runs it through one allocator, in a child process.
+ *
+ * @return true if the child printed its row.
+ */
+static bool compareInChild(const Backend* prototype, const WorkloadConfig* config, uint64_t ops,
+                           indexSize_t block_size, indexSize_t pool_size, uint64_t seed) {
+    fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) return false;
+    if (child > 0) {
+        int status = 0;
+        waitpid(child, &status, 0);
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    Workload workload;
+    WorkloadOp* stream = malloc(ops * sizeof(WorkloadOp));
+    if (!stream || !workloadInit(&workload, config, seed)) _exit(1);
+    for (uint64_t i = 0; i < ops; i++) workloadNext(&workload, &stream[i]);
+    workloadFree(&workload);
+
+    Backend backend = *prototype;
+    Result result;
+    if (!runBackend(&backend, config, stream, ops, block_size, pool_size, &result)) _exit(1);
+    printf("%-14s %-15s %-8s %9.2f %9llu %10llu %10llu %8llu\n", BENCH_CONFIG, config->name, backend.name,
+           result.mops, (unsigned long long)result.rss_kib, (unsigned long long)result.metadata_bytes,
+           (unsigned long long)result.peak_live_bytes, (unsigned long long)result.failures);
+    fflush(stdout);
+    _exit(0);
+}
+
+/* -- Main ----------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+    bool header = false;
+    uint64_t ops = DEFAULT_OPS;
+    uint64_t block_size = DEFAULT_BLOCK_SIZE;
+    uint64_t pool_size = DEFAULT_POOL_SIZE;
+    uint64_t seed = DEFAULT_SEED;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--header") == 0) header = true;
+        else if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc) ops = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--block-size") == 0 && i + 1 < argc) block_size = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--pool-bytes") == 0 && i + 1 < argc) pool_size = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 0);
+        else {
+            fprintf(stderr, "usage: %s [--header] [--ops N] [--block-size B] [--pool-bytes P] [--seed S]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (ops == 0 || block_size == 0 || seed == 0) {
+        fprintf(stderr, "ops, block size and seed must be non-zero\n");
+        return 2;
+    }
+    // Shrink the pool to what the index type can address
+    if (pool_size > INDEXSIZE_MAX) pool_size = INDEXSIZE_MAX / block_size * block_size;
+    if (pool_size < block_size) {
+        fprintf(stderr, "the pool must hold at least one block\n");
+        return 2;
+    }
+
+    if (header) {
+        printf("%-14s %-15s %-8s %9s %9s %10s %10s %8s\n",
+               "config", "workload", "alloc", "Mops/s", "RSS KiB", "metadata", "peak live", "failed");
+    }
+    int status = 0;
+    for (size_t w = 0; w < workload_preset_count; w++) {
+        for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+            if (!compareInChild(&backends[b], &workload_presets[w], ops, (indexSize_t)block_size, (indexSize_t)pool_size, seed)) {
+                fprintf(stderr, "%s failed on %s\n", backends[b].name, workload_presets[w].name);
+                status = 1;
+            }
+        }
+    }
+    return status;
+}
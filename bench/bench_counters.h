@@ -0,0 +1,158 @@
+/**
+ * @file bench_counters.h
+ *
+ * @brief This is an optional reader of hardware performance counters for the allocator benchmarks.
+ *
+ * @details
+ * On Linux the counters are opened with `perf_event_open`, one file descriptor per event, counting
+ * user space only. Each event that cannot be opened, e.g. in a container, under a strict
+ * `perf_event_paranoid` or on hardware without the event, is left out on its own. Its value then
+ * reads as unavailable, and the benchmark still runs. On other systems every event is unavailable.
+ * Values are scaled up when the kernel had to multiplex the counters.
+ *
+ * - benchCountersOpen: Opens every event that is available.
+ * - benchCountersStart/benchCountersStop: Count the events around a benchmark phase.
+ * - benchCountersPrint: Prints the per-operation value of each event, or `-` where unavailable.
+ */
+#ifndef _BENCH_COUNTERS_H_
+#define _BENCH_COUNTERS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* -- Defines -------------------------------------------------------------*/
+
+typedef enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_COUNT,
+} BenchCounter;
+
+static const char* const bench_counter_names[COUNTER_COUNT] = {
+    "cycles/op", "instr/op", "L1d miss/op", "LLC miss/op", "br miss/op",
+};
+
+typedef struct {
+    int fds[COUNTER_COUNT];         ///< File descriptor of each event, or -1 if unavailable.
+    double values[COUNTER_COUNT];   ///< Count of each event over the last phase.
+    int available;                  ///< Number of events that could be opened.
+} BenchCounters;
+
+/* -- Functions -----------------------------------------------------------*/
+
+#ifdef __linux__
+static inline int benchCounterOpen(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+/**
+ * @brief Opens every event that is available.
+ *
+ * @param counters The counters to open.
+ * @return The number of events that could be opened.
+ */
+static inline int benchCountersOpen(BenchCounters* counters) {
+    memset(counters, 0, sizeof(*counters));
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) counters->fds[counter] = -1;
+#ifdef __linux__
+    const uint64_t l1d_read_miss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    counters->fds[COUNTER_CYCLES] = benchCounterOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    counters->fds[COUNTER_INSTRUCTIONS] = benchCounterOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    counters->fds[COUNTER_L1D_MISSES] = benchCounterOpen(PERF_TYPE_HW_CACHE, l1d_read_miss);
+    counters->fds[COUNTER_LLC_MISSES] = benchCounterOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    counters->fds[COUNTER_BRANCH_MISSES] = benchCounterOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        if (counters->fds[counter] >= 0) counters->available++;
+    }
+    return counters->available;
+}
+
+/**
+ * @brief Resets and starts every open event.
+ */
+static inline void benchCountersStart(BenchCounters* counters) {
+#ifdef __linux__
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        if (counters->fds[counter] < 0) continue;
+        ioctl(counters->fds[counter], PERF_EVENT_IOC_RESET, 0);
+        ioctl(counters->fds[counter], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#else
+    (void)counters;
+#endif
+}
+
+/**
+ * @brief Stops every open event and reads its count into `values`.
+ */
+static inline void benchCountersStop(BenchCounters* counters) {
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        counters->values[counter] = 0.0;
+#ifdef __linux__
+        if (counters->fds[counter] < 0) continue;
+        ioctl(counters->fds[counter], PERF_EVENT_IOC_DISABLE, 0);
+        // The value, then the times the event was enabled and actually counting
+        uint64_t reading[3];
+        if (read(counters->fds[counter], reading, sizeof(reading)) != (ssize_t)sizeof(reading)) continue;
+        counters->values[counter] = (reading[2] > 0) ? (double)reading[0] * reading[1] / reading[2] : 0.0;
+#endif
+    }
+}
+
+/**
+ * @brief Closes every open event.
+ */
+static inline void benchCountersClose(BenchCounters* counters) {
+#ifdef __linux__
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        if (counters->fds[counter] >= 0) close(counters->fds[counter]);
+        counters->fds[counter] = -1;
+    }
+#endif
+    counters->available = 0;
+}
+
+/**
+ * @brief Prints the column names of the counters.
+ */
+static inline void benchCountersPrintHeader(void) {
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) printf(" %11s", bench_counter_names[counter]);
+}
+
+/**
+ * @brief Prints the per-operation value of each event of the last phase.
+ *
+ * @param counters The counters read by `benchCountersStop`.
+ * @param ops The number of operations in the phase.
+ */
+static inline void benchCountersPrint(const BenchCounters* counters, uint64_t ops) {
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        if (counters->fds[counter] < 0 || ops == 0) printf(" %11s", "-");
+        else printf(" %11.2f", counters->values[counter] / ops);
+    }
+}
+
+#endif // _BENCH_COUNTERS_H_
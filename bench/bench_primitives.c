@@ -0,0 +1,241 @@
+/**
+ * @file bench_primitives.c
+ *
+ * @brief Microbenchmarks of the bitmap primitives, for comparing `MAPSIZE` word widths.
+ *
+ * @details
+ * The primitives are the private bit functions of `allocator.c` and its free block search, called
+ * directly through `allocator_internal.h`. Each is timed on a hot bitmap, small enough to stay in
+ * L1, and on a cold one, much larger than the last-level cache:
+ *
+ * - getBit/setBit/clearBit: One bit at a random index per call.
+ * - setBits/clearBits: A range of `RANGE_BITS` bits at a random index per call.
+ * - search/fragmented: `findContiguousFreeBlocks` for a run that does not exist, on a map with one used
+ *   block in every `FRAGMENT_GAP`, so the whole map is scanned through many short free runs.
+ * - search/full: The same search on a map that is used except for its last run, so the whole map is
+ *   scanned through used blocks.
+ *
+ * Bit operations report nanoseconds per call. Searches report nanoseconds per search and blocks
+ * scanned per nanosecond; before each cold search the caches are flushed by streaming a large
+ * buffer. The `metadata` row gives the bitmap bytes per block and the padding of a pool whose block
+ * count is not a multiple of the word width, which is where wider words cost memory.
+ *
+ * The calls cross a translation unit, so unlike inside `allocator.c` they are not inlined.
+ * `make primitives` runs this for every supported word width; `MAPSIZE=64` is not supported by the
+ * allocator, whose range masks shift by the full word width.
+ *
+ * Usage: bench_primitives.bench [--header] [--ops N] [--seed S]
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "allocator_internal.h"
+#include "bench_utils.h"
+
+/* -- Defines -------------------------------------------------------------*/
+
+#define DEFAULT_OPS 2000000
+#define DEFAULT_SEED 0x9E3779B97F4A7C15ull
+#define HOT_BLOCKS 4096
+#define COLD_BLOCKS (1ull << 28)
+#define SEARCH_HOT_BLOCKS 4096
+#define SEARCH_COLD_BLOCKS (1ull << 24)
+#define SEARCH_REPEAT 10
+#define RANGE_BITS 48
+#define FRAGMENT_GAP 16
+#define FLUSH_BYTES (64u << 20)
+
+typedef enum {
+    OP_GET,
+    OP_SET,
+    OP_CLEAR,
+    OP_SET_RANGE,
+    OP_CLEAR_RANGE,
+} BitOp;
+
+static const char* const bit_op_names[] = { "getBit", "setBit", "clearBit", "setBits", "clearBits" };
+
+static volatile uint64_t sink;
+
+/* -- Bit Operations ------------------------------------------------------*/
+
+/**
+ * @brief Gets the number of bitmap words that hold a number of blocks, as `allocator.c` lays them out.
+ */
+static uint64_t mapWords(uint64_t blocks) {
+    return (blocks + MAPSIZE - 1) / MAPSIZE * MAP_STRIDE;
+}
+
+/**
+ * @brief Times one bit operation at precomputed random indices.
+ *
+ * @return Nanoseconds per call.
+ */
+static double timeBitOp(BitOp op, mapSize_t* bitmap, const indexSize_t* indices, uint64_t ops) {
+    uint64_t hits = 0;
+    uint64_t start = benchNow();
+    switch (op) {
+    case OP_GET:
+        for (uint64_t i = 0; i < ops; i++) hits += getBit(bitmap, indices[i]);
+        break;
+    case OP_SET:
+        for (uint64_t i = 0; i < ops; i++) setBit(bitmap, indices[i]);
+        break;
+    case OP_CLEAR:
+        for (uint64_t i = 0; i < ops; i++) clearBit(bitmap, indices[i]);
+        break;
+    case OP_SET_RANGE:
+        for (uint64_t i = 0; i < ops; i++) setBits(bitmap, indices[i], RANGE_BITS);
+        break;
+    case OP_CLEAR_RANGE:
+        for (uint64_t i = 0; i < ops; i++) clearBits(bitmap, indices[i], RANGE_BITS);
+        break;
+    }
+    uint64_t elapsed = benchNow() - start;
+    sink += hits;
+    return (double)elapsed / ops;
+}
+
+/**
+ * @brief Times every bit operation on a bitmap of `blocks` bits.
+ *
+ * @param results Receives nanoseconds per call of each operation.
+ * @return false if the bitmap does not fit `indexSize_t` or memory.
+ */
+static bool runBitOps(uint64_t blocks, uint64_t ops, uint64_t seed, double* results) {
+    if (blocks > INDEXSIZE_MAX) return false;
+    mapSize_t* bitmap = calloc(mapWords(blocks), sizeof(mapSize_t));
+    indexSize_t* indices = malloc(ops * sizeof(indexSize_t));
+    bool ok = bitmap && indices;
+    if (ok) {
+        // Ranges must end inside the map
+        for (uint64_t i = 0; i < ops; i++) indices[i] = (indexSize_t)benchRange(&seed, 0, blocks - RANGE_BITS);
+        for (int op = OP_GET; op <= OP_CLEAR_RANGE; op++) results[op] = timeBitOp((BitOp)op, bitmap, indices, ops);
+    }
+    free(bitmap);
+    free(indices);
+    return ok;
+}
+
+/* -- Search --------------------------------------------------------------*/
+
+typedef struct {
+    double ns;              ///< Nanoseconds per search.
+    double blocks_per_ns;   ///< Blocks scanned per nanosecond.
+} SearchResult;
+
+/**
+ * @brief Evicts the caches by streaming through a buffer larger than the last-level cache.
+ */
+static void flushCaches(uint8_t* buffer) {
+    for (size_t i = 0; i < FLUSH_BYTES; i += 64) buffer[i]++;
+}
+
+/**
+ * @brief Times a full scan of the free block search on a pool of `blocks` blocks.
+ *
+ * @param full true to use every block but the last run, false to use one block in every `FRAGMENT_GAP`.
+ * @param flush A buffer to flush the caches with before each search, or NULL for hot searches.
+ * @return false if the pool does not fit `indexSize_t` or memory.
+ */
+static bool runSearch(uint64_t blocks, bool full, uint8_t* flush, SearchResult* result) {
+    if (blocks > INDEXSIZE_MAX) return false;
+    Allocator allocator;
+    indexSize_t metadata_size = allocatorMetadataSize(1, (indexSize_t)blocks);
+    void* metadata = calloc(1, metadata_size);
+    // The search never touches the pool itself, so its pages are never faulted in
+    void* memory = malloc(blocks);
+    if (!metadata || !memory) {
+        free(metadata);
+        free(memory);
+        return false;
+    }
+    initAllocatorExternal(&allocator, 1, metadata, metadata_size, memory, (indexSize_t)blocks);
+    indexSize_t size = allocator.bitmaps.size;
+    if (full) {
+        setBits(allocator.bitmaps.used, 0, size - FRAGMENT_GAP + 1);
+    } else {
+        for (indexSize_t index = FRAGMENT_GAP - 1; index < size; index += FRAGMENT_GAP) setBit(allocator.bitmaps.used, index);
+    }
+
+    uint64_t total = 0;
+    for (int repeat = 0; repeat < SEARCH_REPEAT; repeat++) {
+        if (flush) flushCaches(flush);
+        uint64_t start = benchNow();
+        sink += findContiguousFreeBlocks(&allocator, FRAGMENT_GAP);
+        total += benchNow() - start;
+    }
+    result->ns = (double)total / SEARCH_REPEAT;
+    result->blocks_per_ns = total ? (double)size * SEARCH_REPEAT / total : 0.0;
+    free(metadata);
+    free(memory);
+    return true;
+}
+
+/* -- Main ----------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+    bool header = false;
+    uint64_t ops = DEFAULT_OPS;
+    uint64_t seed = DEFAULT_SEED;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--header") == 0) header = true;
+        else if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc) ops = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 0);
+        else {
+            fprintf(stderr, "usage: %s [--header] [--ops N] [--seed S]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (ops == 0 || seed == 0) {
+        fprintf(stderr, "ops and seed must be non-zero\n");
+        return 2;
+    }
+    uint8_t* flush = calloc(1, FLUSH_BYTES);
+    if (flush == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    if (header) printf("%-14s %-18s %12s %12s %s\n", "config", "primitive", "hot", "cold", "unit");
+
+    // Bit operations; a 16-bit index cannot address a cold map, so it uses the largest it can
+    uint64_t cold_blocks = COLD_BLOCKS < INDEXSIZE_MAX ? COLD_BLOCKS : INDEXSIZE_MAX;
+    double hot[OP_CLEAR_RANGE + 1];
+    double cold[OP_CLEAR_RANGE + 1];
+    if (!runBitOps(HOT_BLOCKS, ops, seed, hot) || !runBitOps(cold_blocks, ops, seed, cold)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (int op = OP_GET; op <= OP_CLEAR_RANGE; op++) {
+        printf("%-14s %-18s %12.2f %12.2f ns/call\n", BENCH_CONFIG, bit_op_names[op], hot[op], cold[op]);
+    }
+
+    // Full scans of the free block search
+    // The allocator rounds the block count up to whole words, which must still fit the index type
+    uint64_t search_cold_blocks = SEARCH_COLD_BLOCKS;
+    if (search_cold_blocks > INDEXSIZE_MAX - MAPSIZE) search_cold_blocks = (INDEXSIZE_MAX - MAPSIZE) / MAPSIZE * MAPSIZE;
+    for (int full = 0; full <= 1; full++) {
+        SearchResult hot_search;
+        SearchResult cold_search;
+        if (!runSearch(SEARCH_HOT_BLOCKS, full, NULL, &hot_search) || !runSearch(search_cold_blocks, full, flush, &cold_search)) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        const char* name = full ? "search/full" : "search/fragmented";
+        printf("%-14s %-18s %12.0f %12.0f ns/search (%llu and %llu blocks)\n", BENCH_CONFIG, name, hot_search.ns, cold_search.ns,
+               (unsigned long long)SEARCH_HOT_BLOCKS, (unsigned long long)search_cold_blocks);
+        printf("%-14s %-18s %12.3f %12.3f blocks/ns\n", BENCH_CONFIG, name, hot_search.blocks_per_ns, cold_search.blocks_per_ns);
+    }
+
+    // Metadata: bitmap bytes per block, and the padding of the last word for an awkward block count
+    uint64_t awkward = SEARCH_HOT_BLOCKS + 1;
+    double per_block = (double)mapWords(SEARCH_HOT_BLOCKS) * BITMAP_COUNT / MAP_STRIDE * sizeof(mapSize_t) / SEARCH_HOT_BLOCKS;
+    uint64_t padding = mapWords(awkward) / MAP_STRIDE * MAPSIZE - awkward;
+    printf("%-14s %-18s %12.3f %12llu bytes/block, padding bits at %llu blocks\n", BENCH_CONFIG, "metadata",
+           per_block, (unsigned long long)padding, (unsigned long long)awkward);
+
+    free(flush);
+    return 0;
+}
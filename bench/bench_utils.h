@@ -0,0 +1,120 @@
+/**
+ * @file bench_utils.h
+ *
+ * @brief This is a minimal benchmarking utility header shared by the allocator benchmarks.
+ *
+ * @details
+ * This header provides the following basic components:
+ *
+ * - benchNow: Reads a monotonic clock in nanoseconds.
+ * - benchRandom: Draws from a seeded xorshift generator, so runs are reproducible.
+ * - benchPercentile: Sorts a set of samples and picks a percentile from them.
+ * - benchMedian: Sorts a set of measurements and picks their median.
+ * - BENCH_CONFIG: A string naming the compile-time configuration of the build.
+ */
+#ifndef _BENCH_UTILS_H_
+#define _BENCH_UTILS_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "allocator.h"
+
+/* -- Defines -------------------------------------------------------------*/
+
+#define STRINGIFY(arg) STRINGIFY_ARG(arg)
+#define STRINGIFY_ARG(arg) #arg
+
+#ifndef BENCH_OPT
+#define BENCH_OPT unknown
+#endif
+
+// Configuration label printed with every result row
+#define BENCH_CONFIG "m" STRINGIFY(MAPSIZE) "/i" STRINGIFY(INDEXSIZE) "/" STRINGIFY(BENCH_OPT)
+
+/* -- Timing --------------------------------------------------------------*/
+
+/**
+ * @brief Reads a monotonic clock.
+ *
+ * @return The current time in nanoseconds.
+ */
+static inline uint64_t benchNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/* -- Random Numbers ------------------------------------------------------*/
+
+/**
+ * @brief Draws the next value of a xorshift64 generator.
+ *
+ * @param state The generator state, which must not be zero.
+ * @return The next pseudo-random value.
+ */
+static inline uint64_t benchRandom(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief Draws a value spread evenly over an inclusive range.
+ *
+ * @param state The generator state, which must not be zero.
+ * @param low The smallest value to draw.
+ * @param high The largest value to draw.
+ * @return A value in [low, high].
+ */
+static inline uint64_t benchRange(uint64_t* state, uint64_t low, uint64_t high) {
+    return low + benchRandom(state) % (high - low + 1);
+}
+
+/* -- Statistics ----------------------------------------------------------*/
+
+static inline int benchCompare(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Gets a percentile of a set of samples.
+ *
+ * @param samples The samples, which are sorted in place.
+ * @param count The number of samples.
+ * @param per_mille The percentile in tenths of a percent, e.g. 500 for the median.
+ * @return The sample at the percentile, or 0 if there are no samples.
+ */
+static inline uint64_t benchPercentile(uint64_t* samples, size_t count, unsigned per_mille) {
+    if (count == 0) return 0;
+    qsort(samples, count, sizeof(uint64_t), benchCompare);
+    size_t rank = (count * per_mille + 999) / 1000;
+    return samples[rank ? rank - 1 : 0];
+}
+
+static inline int benchCompareDouble(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Gets the median of a set of measurements.
+ *
+ * @param values The measurements, which are sorted in place.
+ * @param count The number of measurements.
+ * @return The median, the mean of the middle two for an even count, or 0 if there are none.
+ */
+static inline double benchMedian(double* values, size_t count) {
+    if (count == 0) return 0.0;
+    qsort(values, count, sizeof(double), benchCompareDouble);
+    return (count % 2) ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
+
+#endif // _BENCH_UTILS_H_
@@ -0,0 +1,229 @@
+/**
+ * @file bench_workload.c
+ *
+ * @brief Throughput, latency and peak usage of the allocator under synthetic workloads.
+ *
+ * @details
+ * Each preset workload from `workload.h` is generated up front from the seed, so generating it is not
+ * measured and every build sees the same stream of calls. The stream is then run twice on a fresh
+ * pool: once untimed per call to measure throughput, and once timing each call to measure latency.
+ * Allocations that fail leave their slot empty, and the matching deallocation is skipped. The peak
+ * usage is the high water mark of allocated blocks.
+ *
+ * With `--counters`, hardware counters from `bench_counters.h` are read around the throughput run
+ * and reported per call.
+ *
+ * Usage: bench_workload.bench [--header] [--counters] [--ops N] [--block-size B] [--pool-bytes P] [--seed S]
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "bench_counters.h"
+#include "bench_utils.h"
+#include "workload.h"
+
+/* -- Defines -------------------------------------------------------------*/
+
+#define DEFAULT_OPS 200000
+#define DEFAULT_BLOCK_SIZE 16
+#define DEFAULT_POOL_SIZE (1u << 20)
+#define DEFAULT_SEED 0x9E3779B97F4A7C15ull
+
+typedef struct {
+    double mops;            ///< Millions of `allocate` and `deallocate` calls per second.
+    uint64_t alloc_p50;     ///< Median `allocate` latency in nanoseconds.
+    uint64_t alloc_p99;     ///< 99th percentile `allocate` latency in nanoseconds.
+    uint64_t free_p50;      ///< Median `deallocate` latency in nanoseconds.
+    uint64_t free_p99;      ///< 99th percentile `deallocate` latency in nanoseconds.
+    uint64_t calls;         ///< Calls made by the throughput run.
+    uint64_t peak_bytes;    ///< Most bytes allocated at once.
+    uint64_t failures;      ///< Allocations that returned NULL.
+} Result;
+
+/* -- Workload Driver -----------------------------------------------------*/
+
+typedef struct {
+    Allocator allocator;
+    void* metadata;
+    void* memory;
+    indexSize_t metadata_size;
+    indexSize_t size;
+    void** slots;           ///< Allocation held by each workload slot, or NULL.
+    uint32_t slot_count;
+} Pool;
+
+/**
+ * @brief Creates a pool with external metadata and one pointer per workload slot.
+ *
+ * @return true if memory could be reserved.
+ */
+static bool poolInit(Pool* pool, indexSize_t block_size, indexSize_t size, uint32_t slot_count) {
+    pool->size = size;
+    pool->metadata_size = allocatorMetadataSize(block_size, size);
+    pool->metadata = malloc(pool->metadata_size);
+    pool->memory = malloc(size);
+    pool->slots = malloc(slot_count * sizeof(void*));
+    pool->slot_count = slot_count;
+    pool->allocator.block_size = block_size;
+    if (!pool->metadata || !pool->memory || !pool->slots) {
+        free(pool->metadata);
+        free(pool->memory);
+        free(pool->slots);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Empties the pool and its slots before a pass.
+ */
+static void poolReset(Pool* pool) {
+    memset(pool->metadata, 0, pool->metadata_size);
+    memset(pool->slots, 0, pool->slot_count * sizeof(void*));
+    initAllocatorExternal(&pool->allocator, pool->allocator.block_size, pool->metadata, pool->metadata_size, pool->memory, pool->size);
+}
+
+static void poolFree(Pool* pool) {
+    free(pool->metadata);
+    free(pool->memory);
+    free(pool->slots);
+}
+
+/**
+ * @brief Runs one workload operation on the pool.
+ *
+ * @param ns Receives the latency of the call, or NULL to skip timing.
+ * @return false if the operation was skipped because its allocation had failed.
+ */
+static bool runOp(Pool* pool, const WorkloadOp* op, uint64_t* ns, uint64_t* failures) {
+    uint64_t before = 0;
+    if (op->kind == WORKLOAD_DEALLOCATE) {
+        if (pool->slots[op->slot] == NULL) return false;
+        if (ns) before = benchNow();
+        deallocate(&pool->allocator, pool->slots[op->slot]);
+        if (ns) *ns = benchNow() - before;
+        pool->slots[op->slot] = NULL;
+        return true;
+    }
+    if (ns) before = benchNow();
+    pool->slots[op->slot] = allocate(&pool->allocator, (indexSize_t)op->size);
+    if (ns) *ns = benchNow() - before;
+    if (pool->slots[op->slot] == NULL) (*failures)++;
+    return true;
+}
+
+/**
+ * @brief Generates one workload and runs it for throughput, then again for latency.
+ *
+ * @return true if the workload and pool could be created.
+ */
+static bool runWorkload(const WorkloadConfig* config, indexSize_t block_size, indexSize_t pool_size, uint64_t ops, uint64_t seed, BenchCounters* counters, Result* result) {
+    Workload workload;
+    if (!workloadInit(&workload, config, seed)) return false;
+    WorkloadOp* stream = malloc(ops * sizeof(WorkloadOp));
+    uint64_t* alloc_ns = malloc(ops * sizeof(uint64_t));
+    uint64_t* free_ns = malloc(ops * sizeof(uint64_t));
+    Pool pool;
+    bool ok = stream && alloc_ns && free_ns && poolInit(&pool, block_size, pool_size, config->max_live);
+    if (ok) {
+        memset(result, 0, sizeof(*result));
+        for (uint64_t i = 0; i < ops; i++) workloadNext(&workload, &stream[i]);
+
+        // Throughput: untimed calls
+        poolReset(&pool);
+        if (counters) benchCountersStart(counters);
+        uint64_t start = benchNow();
+        for (uint64_t i = 0; i < ops; i++) {
+            if (runOp(&pool, &stream[i], NULL, &result->failures)) result->calls++;
+        }
+        uint64_t elapsed = benchNow() - start;
+        if (counters) benchCountersStop(counters);
+        result->mops = elapsed ? (result->calls * 1000.0) / (double)elapsed : 0.0;
+        result->peak_bytes = (uint64_t)pool.allocator.stats.high_water_blocks * block_size;
+
+        // Latency: every call timed, failures counted once
+        size_t allocs = 0;
+        size_t frees = 0;
+        uint64_t failures = 0;
+        poolReset(&pool);
+        for (uint64_t i = 0; i < ops; i++) {
+            bool is_free = stream[i].kind == WORKLOAD_DEALLOCATE;
+            uint64_t* ns = is_free ? &free_ns[frees] : &alloc_ns[allocs];
+            if (runOp(&pool, &stream[i], ns, &failures)) {
+                if (is_free) frees++; else allocs++;
+            }
+        }
+        result->alloc_p50 = benchPercentile(alloc_ns, allocs, 500);
+        result->alloc_p99 = benchPercentile(alloc_ns, allocs, 990);
+        result->free_p50 = benchPercentile(free_ns, frees, 500);
+        result->free_p99 = benchPercentile(free_ns, frees, 990);
+        poolFree(&pool);
+    }
+    free(stream);
+    free(alloc_ns);
+    free(free_ns);
+    workloadFree(&workload);
+    return ok;
+}
+
+/* -- Main ----------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+    bool header = false;
+    bool use_counters = false;
+    uint64_t ops = DEFAULT_OPS;
+    uint64_t block_size = DEFAULT_BLOCK_SIZE;
+    uint64_t pool_size = DEFAULT_POOL_SIZE;
+    uint64_t seed = DEFAULT_SEED;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--header") == 0) header = true;
+        else if (strcmp(argv[i], "--counters") == 0) use_counters = true;
+        else if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc) ops = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--block-size") == 0 && i + 1 < argc) block_size = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--pool-bytes") == 0 && i + 1 < argc) pool_size = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 0);
+        else {
+            fprintf(stderr, "usage: %s [--header] [--counters] [--ops N] [--block-size B] [--pool-bytes P] [--seed S]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (ops == 0 || block_size == 0 || seed == 0) {
+        fprintf(stderr, "ops, block size and seed must be non-zero\n");
+        return 2;
+    }
+    // Shrink the default pool to what the index type can address
+    if (pool_size > INDEXSIZE_MAX) pool_size = INDEXSIZE_MAX / block_size * block_size;
+    if (pool_size < block_size) {
+        fprintf(stderr, "the pool must hold at least one block\n");
+        return 2;
+    }
+
+    BenchCounters counters;
+    if (use_counters && benchCountersOpen(&counters) < COUNTER_COUNT) {
+        fprintf(stderr, "some hardware counters are unavailable and show as '-'\n");
+    }
+    if (header) {
+        printf("%-14s %-15s %9s %10s %10s %10s %10s %10s %8s",
+               "config", "workload", "Mops/s", "alloc p50", "alloc p99", "free p50", "free p99", "peak", "failed");
+        if (use_counters) benchCountersPrintHeader();
+        printf("\n");
+    }
+    for (size_t w = 0; w < workload_preset_count; w++) {
+        Result result;
+        if (!runWorkload(&workload_presets[w], (indexSize_t)block_size, (indexSize_t)pool_size, ops, seed, use_counters ? &counters : NULL, &result)) {
+            fprintf(stderr, "out of memory running %s\n", workload_presets[w].name);
+            return 1;
+        }
+        printf("%-14s %-15s %9.2f %8lluns %8lluns %8lluns %8lluns %10llu %8llu",
+               BENCH_CONFIG, workload_presets[w].name, result.mops,
+               (unsigned long long)result.alloc_p50, (unsigned long long)result.alloc_p99,
+               (unsigned long long)result.free_p50, (unsigned long long)result.free_p99,
+               (unsigned long long)result.peak_bytes, (unsigned long long)result.failures);
+        if (use_counters) benchCountersPrint(&counters, result.calls);
+        printf("\n");
+        fflush(stdout);
+    }
+    if (use_counters) benchCountersClose(&counters);
+    return 0;
+}
@@ -0,0 +1,330 @@
+/**
+ * @file block_advisor.c
+ *
+ * @brief Recommends a `block_size` for a workload, from an allocation trace or a size histogram.
+ *
+ * @details
+ * Every candidate block size is simulated and scored on:
+ *
+ * - waste: Rounding waste, as a share of the bytes granted to allocations.
+ * - metadata: Bitmap bytes of a pool just large enough for the peak.
+ * - search: The expected search cost. For a trace, the bitmap words visited per `allocate` in a
+ *   replay on the real allocator, from `SEARCH_COUNTERS`, which this tool is always built with. For
+ *   a histogram, which has no lifetimes, the words of the map holding every allocation at once, which
+ *   a search scans at worst.
+ * - peak: The footprint of a pool sized for the peak, blocks plus metadata. For a histogram every
+ *   allocation is counted as live at once.
+ *
+ * The recommended block size has the smallest peak footprint among the candidates without failures
+ * whose search cost is at most `--max-search-ratio` times the cheapest search. The tool then splits
+ * the sizes at each candidate into a pool of small and a pool of large allocations, picks the best
+ * block size for each the same way, and suggests the best split if it saves at least
+ * `MULTI_POOL_GAIN` percent of the footprint.
+ *
+ * A trace is a file written by `traceWriteFile`; allocations that failed in the recording are replayed
+ * and freed at once. A histogram is a text file of `size count` lines, where `#` starts a comment.
+ *
+ * Usage: block_advisor.bench [--histogram] [--candidates 8,16,...] [--pool-bytes P] [--max-search-ratio R] FILE
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "bench_utils.h"
+#include "trace_file.h"
+
+/* -- Defines -------------------------------------------------------------*/
+
+#define MAX_CANDIDATES 32
+#define MAX_HISTOGRAM 4096
+#define DEFAULT_MAX_SEARCH_RATIO 2.0
+#define MULTI_POOL_GAIN 10.0
+
+#ifndef SEARCH_COUNTERS
+#error "block_advisor needs SEARCH_COUNTERS"
+#endif
+
+static const uint64_t default_candidates[] = { 4, 8, 16, 32, 64, 128, 256, 512, 1024 };
+
+typedef struct {
+    uint32_t size;
+    uint64_t count;
+} HistogramEntry;
+
+typedef struct {
+    const TraceFileHeader* header;
+    const TraceRecord* records;     ///< Trace records, or NULL for a histogram.
+    const HistogramEntry* histogram;
+    size_t histogram_count;
+    uint64_t pool_size;             ///< Pool size of the trace replays, in bytes.
+} Workload;
+
+typedef struct {
+    uint64_t block_size;
+    uint64_t allocations;
+    uint64_t requested_bytes;
+    uint64_t granted_bytes;
+    uint64_t metadata_bytes;    ///< Bitmap bytes for a pool sized to the peak.
+    double search;              ///< Words visited per allocation, or map words of a histogram.
+    uint64_t peak_bytes;        ///< Blocks and metadata of a pool sized to the peak.
+    uint64_t failures;
+} Candidate;
+
+/* -- Simulation ----------------------------------------------------------*/
+
+/**
+ * @brief Replays the allocations of a trace with sizes in [min_size, max_size].
+ *
+ * @return false if the pool does not fit `indexSize_t` or memory.
+ */
+static bool simulateTrace(const Workload* workload, uint32_t min_size, uint32_t max_size, Candidate* candidate) {
+    uint64_t block_size = candidate->block_size;
+    uint64_t pool_blocks = workload->pool_size / block_size;
+    // The allocator rounds the block count up to whole words, which must still fit the index type
+    if (pool_blocks > INDEXSIZE_MAX - MAPSIZE) pool_blocks = (INDEXSIZE_MAX - MAPSIZE) / MAPSIZE * MAPSIZE;
+    uint64_t pool_size = pool_blocks * block_size;
+    if (pool_blocks == 0 || pool_size > INDEXSIZE_MAX) return false;
+    uint64_t recorded_blocks = workload->header->pool_size / workload->header->block_size;
+    indexSize_t metadata_size = allocatorMetadataSize((indexSize_t)block_size, (indexSize_t)pool_size);
+    void* metadata = calloc(1, metadata_size);
+    // The allocator never touches the blocks, so the pool is never faulted in
+    void* memory = malloc(pool_size);
+    void** live = calloc(recorded_blocks ? recorded_blocks : 1, sizeof(void*));
+    bool ok = metadata && memory && live;
+    if (ok) {
+        Allocator allocator;
+        initAllocatorExternal(&allocator, (indexSize_t)block_size, metadata, metadata_size, memory, (indexSize_t)pool_size);
+        for (uint64_t i = 0; i < workload->header->count; i++) {
+            const TraceRecord* record = &workload->records[i];
+            TraceOp op = TRACE_RECORD_OP(record);
+            if (op == TRACE_DEALLOCATE) {
+                if (record->index < recorded_blocks && live[record->index]) {
+                    deallocate(&allocator, live[record->index]);
+                    live[record->index] = NULL;
+                }
+                continue;
+            }
+            if ((op != TRACE_ALLOCATE && op != TRACE_FAILED) || record->size < min_size || record->size > max_size) continue;
+            void* block = allocate(&allocator, (indexSize_t)record->size);
+            candidate->allocations++;
+            if (block == NULL) {
+                candidate->failures++;
+                continue;
+            }
+            candidate->requested_bytes += record->size;
+            candidate->granted_bytes += (record->size + block_size - 1) / block_size * block_size;
+            if (op == TRACE_ALLOCATE && record->index < recorded_blocks) live[record->index] = block;
+            else deallocate(&allocator, block);
+        }
+        SearchCounters search = getSearchCounters(&allocator);
+        uint64_t peak_blocks = getAllocatorStats(&allocator).high_water_blocks;
+        candidate->search = search.searches ? (double)search.words_visited / search.searches : 0.0;
+        candidate->metadata_bytes = peak_blocks ? allocatorMetadataSize((indexSize_t)block_size, (indexSize_t)(peak_blocks * block_size)) : 0;
+        candidate->peak_bytes = peak_blocks * block_size + candidate->metadata_bytes;
+    }
+    free(metadata);
+    free(memory);
+    free(live);
+    return ok;
+}
+
+/**
+ * @brief Computes the rounding of the allocations of a histogram with sizes in [min_size, max_size].
+ */
+static void simulateHistogram(const Workload* workload, uint32_t min_size, uint32_t max_size, Candidate* candidate) {
+    uint64_t block_size = candidate->block_size;
+    uint64_t blocks = 0;
+    for (size_t i = 0; i < workload->histogram_count; i++) {
+        const HistogramEntry* entry = &workload->histogram[i];
+        if (entry->size < min_size || entry->size > max_size) continue;
+        uint64_t entry_blocks = (entry->size + block_size - 1) / block_size;
+        candidate->allocations += entry->count;
+        candidate->requested_bytes += (uint64_t)entry->size * entry->count;
+        candidate->granted_bytes += entry_blocks * block_size * entry->count;
+        blocks += entry_blocks * entry->count;
+    }
+    // Bitmaps of one bit per block for each map, as allocatorMetadataSize counts them, without its index limit
+    uint64_t words = (blocks + MAPSIZE - 1) / MAPSIZE;
+    candidate->search = (double)words;
+    candidate->metadata_bytes = words * BITMAP_COUNT * sizeof(mapSize_t);
+#ifdef RUN_LENGTHS
+    candidate->metadata_bytes += words * MAPSIZE * sizeof(runLength_t);
+#endif
+    candidate->peak_bytes = blocks * block_size + candidate->metadata_bytes;
+}
+
+static bool simulate(const Workload* workload, uint32_t min_size, uint32_t max_size, uint64_t block_size, Candidate* candidate) {
+    memset(candidate, 0, sizeof(*candidate));
+    candidate->block_size = block_size;
+    if (workload->records == NULL) {
+        simulateHistogram(workload, min_size, max_size, candidate);
+        return true;
+    }
+    return simulateTrace(workload, min_size, max_size, candidate);
+}
+
+/**
+ * @brief Picks the candidate with the smallest peak among those without failures and with an
+ * acceptable search cost.
+ *
+ * @return The index of the chosen candidate, or -1 if every candidate failed.
+ */
+static int recommend(const Candidate* candidates, size_t count, double max_search_ratio) {
+    double cheapest = -1.0;
+    for (size_t i = 0; i < count; i++) {
+        if (candidates[i].failures == 0 && (cheapest < 0 || candidates[i].search < cheapest)) cheapest = candidates[i].search;
+    }
+    int best = -1;
+    for (size_t i = 0; i < count; i++) {
+        const Candidate* candidate = &candidates[i];
+        if (candidate->failures > 0 || candidate->search > cheapest * max_search_ratio) continue;
+        if (best < 0 || candidate->peak_bytes < candidates[best].peak_bytes) best = (int)i;
+    }
+    return best;
+}
+
+/* -- Input ---------------------------------------------------------------*/
+
+static size_t readHistogram(const char* path, HistogramEntry* entries, size_t capacity) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return 0;
+    char line[256];
+    size_t count = 0;
+    while (count < capacity && fgets(line, sizeof(line), file)) {
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+        unsigned long size;
+        unsigned long long entry_count;
+        if (sscanf(line, "%lu %llu", &size, &entry_count) != 2 || size == 0 || size > UINT32_MAX) continue;
+        entries[count++] = (HistogramEntry){ .size = (uint32_t)size, .count = entry_count };
+    }
+    fclose(file);
+    return count;
+}
+
+static size_t parseCandidates(const char* list, uint64_t* candidates) {
+    size_t count = 0;
+    while (*list && count < MAX_CANDIDATES) {
+        char* end;
+        uint64_t value = strtoull(list, &end, 0);
+        if (end == list) break;
+        if (value > 0) candidates[count++] = value;
+        list = (*end == ',') ? end + 1 : end;
+    }
+    return count;
+}
+
+/* -- Main ----------------------------------------------------------------*/
+
+static void printCandidate(const Candidate* candidate, bool chosen) {
+    double waste = candidate->granted_bytes ? 100.0 * (candidate->granted_bytes - candidate->requested_bytes) / candidate->granted_bytes : 0.0;
+    printf("%-14s %8llu %7.1f%% %10llu %10.1f %12llu %8llu%s\n", BENCH_CONFIG, (unsigned long long)candidate->block_size, waste,
+           (unsigned long long)candidate->metadata_bytes, candidate->search, (unsigned long long)candidate->peak_bytes,
+           (unsigned long long)candidate->failures, chosen ? "  <- recommended" : "");
+}
+
+int main(int argc, char** argv) {
+    bool histogram = false;
+    uint64_t candidate_sizes[MAX_CANDIDATES];
+    size_t candidate_count = sizeof(default_candidates) / sizeof(default_candidates[0]);
+    memcpy(candidate_sizes, default_candidates, sizeof(default_candidates));
+    uint64_t pool_size = 0;
+    double max_search_ratio = DEFAULT_MAX_SEARCH_RATIO;
+    const char* path = NULL;
+    bool valid = true;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--histogram") == 0) histogram = true;
+        else if (strcmp(argv[i], "--candidates") == 0 && i + 1 < argc) candidate_count = parseCandidates(argv[++i], candidate_sizes);
+        else if (strcmp(argv[i], "--pool-bytes") == 0 && i + 1 < argc) pool_size = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--max-search-ratio") == 0 && i + 1 < argc) max_search_ratio = strtod(argv[++i], NULL);
+        else if (argv[i][0] != '-' && path == NULL) path = argv[i];
+        else valid = false;
+    }
+    if (!valid || path == NULL || candidate_count == 0 || max_search_ratio < 1.0) {
+        fprintf(stderr, "usage: %s [--histogram] [--candidates 8,16,...] [--pool-bytes P] [--max-search-ratio R] FILE\n", argv[0]);
+        return 2;
+    }
+
+    Workload workload = { 0 };
+    TraceFileHeader header;
+    TraceRecord* records = NULL;
+    static HistogramEntry entries[MAX_HISTOGRAM];
+    uint32_t max_size = 0;
+    if (histogram) {
+        workload.histogram = entries;
+        workload.histogram_count = readHistogram(path, entries, MAX_HISTOGRAM);
+        for (size_t i = 0; i < workload.histogram_count; i++) if (entries[i].size > max_size) max_size = entries[i].size;
+    } else {
+        records = traceReadFile(path, &header);
+        workload.header = &header;
+        workload.records = records;
+        // Room for the recorded peak at any candidate, within what the index type can address
+        workload.pool_size = pool_size ? pool_size : header.pool_size * 4;
+        if (workload.pool_size > INDEXSIZE_MAX) workload.pool_size = INDEXSIZE_MAX;
+        for (uint64_t i = 0; records && i < header.count; i++) if (records[i].size > max_size) max_size = records[i].size;
+    }
+    if ((histogram && workload.histogram_count == 0) || (!histogram && records == NULL)) {
+        fprintf(stderr, "%s is not a readable %s\n", path, histogram ? "histogram" : "trace");
+        return 1;
+    }
+
+    // One pool for every size
+    Candidate single[MAX_CANDIDATES];
+    for (size_t i = 0; i < candidate_count; i++) {
+        if (!simulate(&workload, 0, UINT32_MAX, candidate_sizes[i], &single[i])) single[i].failures = UINT64_MAX;
+    }
+    int best = recommend(single, candidate_count, max_search_ratio);
+    printf("%-14s %8s %8s %10s %10s %12s %8s\n", "config", "block", "waste", "metadata", histogram ? "map words" : "words/alloc", "peak", "failed");
+    for (size_t i = 0; i < candidate_count; i++) {
+        if (single[i].failures == UINT64_MAX) {
+            printf("%-14s %8llu %8s\n", BENCH_CONFIG, (unsigned long long)candidate_sizes[i], "skipped");
+            continue;
+        }
+        printCandidate(&single[i], (int)i == best);
+    }
+    if (best < 0) {
+        printf("no candidate block size served the workload without failures\n");
+        free(records);
+        return 1;
+    }
+
+    // Two pools, split at each candidate size
+    uint64_t best_total = single[best].peak_bytes;
+    int split_at = -1;
+    int split_small = -1;
+    int split_large = -1;
+    for (size_t split = 0; split < candidate_count; split++) {
+        uint32_t threshold = (uint32_t)candidate_sizes[split];
+        if (threshold >= max_size) continue;
+        Candidate small[MAX_CANDIDATES];
+        Candidate large[MAX_CANDIDATES];
+        for (size_t i = 0; i < candidate_count; i++) {
+            if (!simulate(&workload, 0, threshold, candidate_sizes[i], &small[i])) small[i].failures = UINT64_MAX;
+            if (!simulate(&workload, threshold + 1, UINT32_MAX, candidate_sizes[i], &large[i])) large[i].failures = UINT64_MAX;
+        }
+        int small_best = recommend(small, candidate_count, max_search_ratio);
+        int large_best = recommend(large, candidate_count, max_search_ratio);
+        if (small_best < 0 || large_best < 0) continue;
+        uint64_t total = small[small_best].peak_bytes + large[large_best].peak_bytes;
+        if (total < best_total) {
+            best_total = total;
+            split_at = (int)split;
+            split_small = small_best;
+            split_large = large_best;
+        }
+    }
+
+    printf("\nrecommended: block_size %llu, peak %llu bytes\n",
+           (unsigned long long)single[best].block_size, (unsigned long long)single[best].peak_bytes);
+    double gain = 100.0 * (double)(single[best].peak_bytes - best_total) / (double)single[best].peak_bytes;
+    if (split_at >= 0 && gain >= MULTI_POOL_GAIN) {
+        printf("better: two pools, sizes up to %llu with block_size %llu and larger sizes with block_size %llu, "
+               "peak %llu bytes (%.1f%% less)\n", (unsigned long long)candidate_sizes[split_at],
+               (unsigned long long)candidate_sizes[split_small], (unsigned long long)candidate_sizes[split_large],
+               (unsigned long long)best_total, gain);
+    } else {
+        printf("a second pool would save less than %.0f%% of the peak\n", MULTI_POOL_GAIN);
+    }
+    free(records);
+    return 0;
+}
@@ -0,0 +1,363 @@
+/**
+ * @file heatmap.c
+ *
+ * @brief Renders the layout of a pool from a snapshot written by `dumpAllocator`.
+ *
+ * @details
+ * The pool is downsampled to a grid of cells, each covering an equal share of the blocks, and each
+ * cell is shaded by the share of its blocks in use. The largest free runs are annotated: every cell
+ * they cover entirely is drawn with their letter, and a legend gives their start and length. A
+ * summary gives the allocations, free runs and external fragmentation of the whole pool.
+ *
+ * - ASCII: Printed to stdout, from ' ' for a free cell to '@' for a full one.
+ * - PPM: With `--ppm FILE`, a binary PPM image of `--scale` pixels per cell, green for free through
+ *   red for full, with the annotated runs in blue.
+ *
+ * A snapshot is a file holding the bytes `dumpAllocator` wrote. To get one without an application,
+ * `--workload NAME` runs a preset workload from `workload.h` on a fresh pool, renders the pool at
+ * the end, and saves its snapshot with `--save FILE`.
+ *
+ * Usage: heatmap.bench [--width W] [--rows R] [--runs K] [--ppm FILE] [--scale S] DUMP
+ *        heatmap.bench --workload NAME [--ops N] [--block-size B] [--pool-bytes P] [--seed S] [--save DUMP] [...]
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "bench_utils.h"
+#include "workload.h"
+
+/* -- Defines -------------------------------------------------------------*/
+
+#define DEFAULT_WIDTH 64
+#define DEFAULT_ROWS 16
+#define DEFAULT_RUNS 5
+#define DEFAULT_SCALE 8
+#define MAX_RUNS 26
+#define DEFAULT_OPS 200000
+#define DEFAULT_BLOCK_SIZE 16
+#define DEFAULT_POOL_SIZE 65536
+#define DEFAULT_SEED 0x9E3779B97F4A7C15ull
+
+static const char shades[] = " .:-=+*#%@";
+
+typedef struct {
+    AllocatorDumpHeader header;
+    const uint8_t* used;        ///< Packed `used` bitmap.
+    const uint8_t* heads;       ///< Packed `heads` bitmap.
+    uint8_t* bytes;             ///< The whole snapshot.
+} Dump;
+
+typedef struct {
+    uint64_t start;             ///< First block of the run.
+    uint64_t length;            ///< Number of blocks in the run.
+} FreeRun;
+
+typedef struct {
+    uint64_t width;
+    uint64_t rows;
+    uint64_t blocks_per_cell;
+    uint64_t* used;             ///< Used blocks of each cell.
+    uint64_t* size;             ///< Blocks of each cell; the last cells may hold fewer.
+    int* run;                   ///< Annotated free run covering each cell, or -1.
+} Grid;
+
+/* -- Snapshot ------------------------------------------------------------*/
+
+static bool bitAt(const uint8_t* map, uint64_t index) {
+    return (map[index / 8] >> (index % 8)) & 1;
+}
+
+/**
+ * @brief Checks a snapshot and points `dump` at its bitmaps.
+ *
+ * @param bytes The snapshot, which `dump` takes ownership of.
+ */
+static bool openDump(uint8_t* bytes, size_t size, Dump* dump) {
+    if (size < sizeof(AllocatorDumpHeader)) return false;
+    memcpy(&dump->header, bytes, sizeof(dump->header));
+    uint64_t map_bytes = (dump->header.blocks + 7) / 8;
+    if (dump->header.magic != ALLOCATOR_DUMP_MAGIC || dump->header.version != ALLOCATOR_DUMP_VERSION
+        || size != sizeof(AllocatorDumpHeader) + 2 * map_bytes) return false;
+    dump->bytes = bytes;
+    dump->used = bytes + sizeof(AllocatorDumpHeader);
+    dump->heads = dump->used + map_bytes;
+    return true;
+}
+
+static bool readDump(const char* path, Dump* dump) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* bytes = malloc(size > 0 ? (size_t)size : 1);
+    bool ok = bytes && size > 0 && fread(bytes, 1, (size_t)size, file) == (size_t)size;
+    fclose(file);
+    if (ok) ok = openDump(bytes, (size_t)size, dump);
+    if (!ok) free(bytes);
+    return ok;
+}
+
+static bool writeDump(const char* path, const Dump* dump) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) return false;
+    size_t size = sizeof(AllocatorDumpHeader) + 2 * (size_t)((dump->header.blocks + 7) / 8);
+    bool ok = fwrite(dump->bytes, 1, size, file) == size;
+    return (fclose(file) == 0) && ok;
+}
+
+/**
+ * @brief Runs a preset workload on a fresh pool and takes a snapshot of the pool at the end.
+ */
+static bool runWorkload(const WorkloadConfig* config, uint64_t ops, uint64_t block_size, uint64_t pool_size, uint64_t seed, Dump* dump) {
+    Workload workload;
+    Allocator allocator;
+    indexSize_t metadata_size = allocatorMetadataSize((indexSize_t)block_size, (indexSize_t)pool_size);
+    void* metadata = calloc(1, metadata_size);
+    void* memory = calloc(1, pool_size);
+    void** slots = calloc(config->max_live, sizeof(void*));
+    bool ok = metadata && memory && slots && workloadInit(&workload, config, seed);
+    if (ok) {
+        initAllocatorExternal(&allocator, (indexSize_t)block_size, metadata, metadata_size, memory, (indexSize_t)pool_size);
+        for (uint64_t i = 0; i < ops; i++) {
+            WorkloadOp op;
+            workloadNext(&workload, &op);
+            if (op.kind == WORKLOAD_ALLOCATE) {
+                slots[op.slot] = allocate(&allocator, (indexSize_t)op.size);
+            } else if (slots[op.slot] != NULL) {
+                deallocate(&allocator, slots[op.slot]);
+                slots[op.slot] = NULL;
+            }
+        }
+        workloadFree(&workload);
+        size_t size = dumpAllocator(&allocator, NULL, 0);
+        uint8_t* bytes = malloc(size);
+        ok = bytes && dumpAllocator(&allocator, bytes, size) == size && openDump(bytes, size, dump);
+        if (!ok) free(bytes);
+    }
+    free(metadata);
+    free(memory);
+    free(slots);
+    return ok;
+}
+
+/* -- Rendering -----------------------------------------------------------*/
+
+/**
+ * @brief Finds the free runs of a snapshot, keeping the `capacity` largest, longest first.
+ *
+ * @return The number of runs kept.
+ */
+static size_t largestFreeRuns(const Dump* dump, FreeRun* runs, size_t capacity, uint64_t* run_count, uint64_t* free_blocks) {
+    size_t count = 0;
+    *run_count = 0;
+    *free_blocks = 0;
+    uint64_t blocks = dump->header.blocks;
+    for (uint64_t index = 0; index < blocks;) {
+        if (bitAt(dump->used, index)) {
+            index++;
+            continue;
+        }
+        FreeRun run = { .start = index, .length = 0 };
+        while (index < blocks && !bitAt(dump->used, index)) index++;
+        run.length = index - run.start;
+        (*run_count)++;
+        *free_blocks += run.length;
+        // Insert into the kept runs, longest first
+        size_t at = count < capacity ? count++ : capacity;
+        while (at > 0 && runs[at - 1].length < run.length) {
+            if (at < capacity) runs[at] = runs[at - 1];
+            at--;
+        }
+        if (at < capacity) runs[at] = run;
+    }
+    return count;
+}
+
+static bool buildGrid(const Dump* dump, const FreeRun* runs, size_t run_count, Grid* grid) {
+    uint64_t blocks = dump->header.blocks;
+    uint64_t cells = grid->width * grid->rows;
+    grid->blocks_per_cell = (blocks + cells - 1) / cells;
+    if (grid->blocks_per_cell == 0) grid->blocks_per_cell = 1;
+    // Fewer rows when the pool has fewer blocks than the grid has cells
+    grid->rows = ((blocks + grid->blocks_per_cell - 1) / grid->blocks_per_cell + grid->width - 1) / grid->width;
+    cells = grid->width * grid->rows;
+    grid->used = calloc(cells, sizeof(uint64_t));
+    grid->size = calloc(cells, sizeof(uint64_t));
+    grid->run = malloc(cells * sizeof(int));
+    if (!grid->used || !grid->size || !grid->run) return false;
+    for (uint64_t index = 0; index < blocks; index++) {
+        uint64_t cell = index / grid->blocks_per_cell;
+        grid->size[cell]++;
+        grid->used[cell] += bitAt(dump->used, index);
+    }
+    for (uint64_t cell = 0; cell < cells; cell++) {
+        grid->run[cell] = -1;
+        uint64_t first = cell * grid->blocks_per_cell;
+        uint64_t end = first + grid->size[cell];
+        for (size_t i = 0; i < run_count && grid->size[cell] > 0; i++) {
+            if (runs[i].start <= first && end <= runs[i].start + runs[i].length) grid->run[cell] = (int)i;
+        }
+    }
+    return true;
+}
+
+static void printAscii(const Grid* grid) {
+    for (uint64_t row = 0; row < grid->rows; row++) {
+        printf("%10llu |", (unsigned long long)(row * grid->width * grid->blocks_per_cell));
+        for (uint64_t column = 0; column < grid->width; column++) {
+            uint64_t cell = row * grid->width + column;
+            char c = ' ';
+            if (grid->size[cell] > 0 && grid->run[cell] >= 0) c = (char)('a' + grid->run[cell]);
+            else if (grid->used[cell] > 0) {
+                // Any use shows, and only a full cell gets the darkest shade
+                uint64_t levels = sizeof(shades) - 2;
+                uint64_t shade = 1 + (grid->used[cell] * (levels - 1)) / grid->size[cell];
+                if (grid->used[cell] == grid->size[cell]) shade = levels;
+                c = shades[shade];
+            }
+            putchar(c);
+        }
+        printf("|\n");
+    }
+}
+
+static bool writePpm(const char* path, const Grid* grid, uint64_t scale) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) return false;
+    fprintf(file, "P6\n%llu %llu\n255\n", (unsigned long long)(grid->width * scale), (unsigned long long)(grid->rows * scale));
+    bool ok = true;
+    for (uint64_t y = 0; ok && y < grid->rows * scale; y++) {
+        for (uint64_t x = 0; ok && x < grid->width * scale; x++) {
+            uint64_t cell = (y / scale) * grid->width + x / scale;
+            uint8_t pixel[3] = { 0, 0, 0 };
+            if (grid->size[cell] > 0 && grid->run[cell] >= 0) {
+                pixel[0] = 40, pixel[1] = 90, pixel[2] = 230;
+            } else if (grid->size[cell] > 0) {
+                double share = (double)grid->used[cell] / grid->size[cell];
+                pixel[0] = (uint8_t)(40 + 215 * share);
+                pixel[1] = (uint8_t)(200 * (1.0 - share));
+                pixel[2] = 40;
+            }
+            ok = fwrite(pixel, 1, sizeof(pixel), file) == sizeof(pixel);
+        }
+    }
+    return (fclose(file) == 0) && ok;
+}
+
+/* -- Main ----------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+    uint64_t width = DEFAULT_WIDTH;
+    uint64_t rows = DEFAULT_ROWS;
+    uint64_t run_limit = DEFAULT_RUNS;
+    uint64_t scale = DEFAULT_SCALE;
+    const char* ppm = NULL;
+    const char* save = NULL;
+    const char* name = NULL;
+    uint64_t ops = DEFAULT_OPS;
+    uint64_t block_size = DEFAULT_BLOCK_SIZE;
+    uint64_t pool_size = DEFAULT_POOL_SIZE;
+    uint64_t seed = DEFAULT_SEED;
+    const char* path = NULL;
+    bool valid = true;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) width = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc) rows = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) run_limit = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--ppm") == 0 && i + 1 < argc) ppm = argv[++i];
+        else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) scale = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) save = argv[++i];
+        else if (strcmp(argv[i], "--workload") == 0 && i + 1 < argc) name = argv[++i];
+        else if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc) ops = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--block-size") == 0 && i + 1 < argc) block_size = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--pool-bytes") == 0 && i + 1 < argc) pool_size = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 0);
+        else if (argv[i][0] != '-' && path == NULL) path = argv[i];
+        else valid = false;
+    }
+    if (!valid || (path == NULL) == (name == NULL)) {
+        fprintf(stderr, "usage: %s [--width W] [--rows R] [--runs K] [--ppm FILE] [--scale S] DUMP\n"
+                        "       %s --workload NAME [--ops N] [--block-size B] [--pool-bytes P] [--seed S] [--save DUMP] [...]\n",
+                argv[0], argv[0]);
+        return 2;
+    }
+    if (width == 0 || rows == 0 || scale == 0 || block_size == 0 || seed == 0) {
+        fprintf(stderr, "width, rows, scale, block size and seed must be non-zero\n");
+        return 2;
+    }
+    if (run_limit > MAX_RUNS) run_limit = MAX_RUNS;
+
+    Dump dump;
+    if (name != NULL) {
+        const WorkloadConfig* config = workloadFind(name);
+        if (config == NULL) {
+            fprintf(stderr, "unknown workload %s; presets are:", name);
+            for (size_t i = 0; i < workload_preset_count; i++) fprintf(stderr, " %s", workload_presets[i].name);
+            fprintf(stderr, "\n");
+            return 2;
+        }
+        // Shrink the pool to what the index type can address
+        if (pool_size > INDEXSIZE_MAX) pool_size = INDEXSIZE_MAX / block_size * block_size;
+        if (pool_size < block_size) {
+            fprintf(stderr, "the pool must hold at least one block\n");
+            return 2;
+        }
+        if (!runWorkload(config, ops, block_size, pool_size, seed, &dump)) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        if (save && !writeDump(save, &dump)) {
+            fprintf(stderr, "could not write %s\n", save);
+            return 1;
+        }
+    } else if (!readDump(path, &dump)) {
+        fprintf(stderr, "%s is not a readable allocator snapshot\n", path);
+        return 1;
+    }
+
+    FreeRun runs[MAX_RUNS];
+    uint64_t run_count;
+    uint64_t free_blocks;
+    size_t kept = largestFreeRuns(&dump, runs, run_limit, &run_count, &free_blocks);
+    Grid grid = { .width = width, .rows = rows };
+    if (!buildGrid(&dump, runs, kept, &grid)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    const AllocatorDumpHeader* header = &dump.header;
+    uint64_t heads = 0;
+    for (uint64_t index = 0; index < header->blocks; index++) heads += bitAt(dump.heads, index);
+    double used = header->blocks ? 100.0 * (header->blocks - free_blocks) / header->blocks : 0.0;
+    double external = free_blocks ? 1.0 - (double)(kept ? runs[0].length : 0) / free_blocks : 0.0;
+    printf("pool: %llu blocks of %llu bytes (m%u/i%u), %.1f%% used, high water %llu blocks\n",
+           (unsigned long long)header->blocks, (unsigned long long)header->block_size, header->mapsize, header->indexsize,
+           used, (unsigned long long)header->high_water_blocks);
+    printf("allocations: %llu, %.1f blocks each; free runs: %llu, largest %llu blocks; external fragmentation %.3f\n",
+           (unsigned long long)heads, heads ? (double)(header->blocks - free_blocks) / heads : 0.0,
+           (unsigned long long)run_count, (unsigned long long)(kept ? runs[0].length : 0), external);
+    printf("%llu blocks per cell, shades \"%s\" from free to full, letters mark the largest free runs\n\n",
+           (unsigned long long)grid.blocks_per_cell, shades);
+    printAscii(&grid);
+    printf("\n");
+    for (size_t i = 0; i < kept; i++) {
+        bool shown = false;
+        for (uint64_t cell = 0; cell < grid.width * grid.rows && !shown; cell++) shown = grid.run[cell] == (int)i;
+        printf("%c  free run of %llu blocks (%llu bytes) at block %llu%s\n", (int)('a' + i),
+               (unsigned long long)runs[i].length, (unsigned long long)(runs[i].length * header->block_size),
+               (unsigned long long)runs[i].start, shown ? "" : ", covers no whole cell");
+    }
+
+    int status = 0;
+    if (ppm && !writePpm(ppm, &grid, scale)) {
+        fprintf(stderr, "could not write %s\n", ppm);
+        status = 1;
+    }
+    free(grid.used);
+    free(grid.size);
+    free(grid.run);
+    free(dump.bytes);
+    return status;
+}
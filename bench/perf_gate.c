@@ -0,0 +1,275 @@
+/**
+ * @file perf_gate.c
+ *
+ * @brief Compares a benchmark run against a stored baseline and fails on significant slowdowns.
+ *
+ * @details
+ * Both files are JSON documents written by `bench_allocator.bench --json --repeat N`. For every
+ * benchmark in the baseline, the repetitions of one metric are compared through the ratio of the
+ * run to the baseline: the estimate is the median of the ratios of every pair of repetitions, and
+ * its distribution-free confidence interval is taken from the order statistics of those ratios.
+ * The intervals hold jointly at 95%: with m benchmarks, each one is a 1 - 0.05/m interval
+ * (Bonferroni). A benchmark counts as slower only if its whole interval is worse than the threshold.
+ *
+ * The more benchmarks, the more repetitions the intervals need. With too few, e.g. five per file
+ * for the 15 benchmarks of `make perf-gate`, the intervals are unbounded, nothing can fail the
+ * gate and it prints a warning. Throughput metrics (`mops`) are better when higher, every other
+ * metric when lower.
+ *
+ * The reader only understands the layout written by `bench_allocator`, not JSON in general.
+ *
+ * Usage: perf_gate.bench [--metric NAME] [--threshold PERCENT] BASELINE RUN
+ *
+ * Exits with 0 if nothing got slower, 1 if something did and 2 if the files could not be read.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench_utils.h"
+
+/* -- Defines -------------------------------------------------------------*/
+
+#define DEFAULT_METRIC "mops"
+#define DEFAULT_THRESHOLD 10.0
+#define FAMILY_ERROR 0.05
+#define MAX_BENCHMARKS 256
+#define MAX_SAMPLES 100
+#define MAX_NAME 64
+
+typedef struct {
+    char name[MAX_NAME];
+    double samples[MAX_SAMPLES];
+    size_t count;
+} Series;
+
+typedef struct {
+    char config[MAX_NAME];
+    Series series[MAX_BENCHMARKS];
+    size_t count;
+} Run;
+
+typedef struct {
+    double ratio;   ///< Median of the pairwise ratios of the run to the baseline.
+    double low;     ///< Lower bound of the confidence interval of the ratio.
+    double high;    ///< Upper bound of the confidence interval of the ratio.
+    bool bounded;   ///< false if there are too few pairs for the interval, which is then [0, infinity].
+} Estimate;
+
+/* -- Reading -------------------------------------------------------------*/
+
+/**
+ * @brief Reads the string value of `key` that follows `text`.
+ *
+ * @return A pointer past the value, or NULL if there is no such key.
+ */
+static const char* readString(const char* text, const char* key, char* value, size_t capacity) {
+    char pattern[MAX_NAME + 2];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    const char* at = strstr(text, pattern);
+    if (at == NULL) return NULL;
+    at = strchr(at + strlen(pattern), '"');
+    if (at == NULL) return NULL;
+    const char* end = strchr(++at, '"');
+    if (end == NULL) return NULL;
+    size_t length = (size_t)(end - at) < capacity - 1 ? (size_t)(end - at) : capacity - 1;
+    memcpy(value, at, length);
+    value[length] = '\0';
+    return end + 1;
+}
+
+/**
+ * @brief Reads the numbers of the array value of `key`, if it comes before `limit`.
+ *
+ * @return The number of values read.
+ */
+static size_t readArray(const char* text, const char* limit, const char* key, double* values, size_t capacity) {
+    char pattern[MAX_NAME + 2];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    const char* at = strstr(text, pattern);
+    if (at == NULL || (limit && at > limit)) return 0;
+    at = strchr(at, '[');
+    if (at == NULL) return 0;
+    size_t count = 0;
+    for (at++; count < capacity;) {
+        char* end;
+        double value = strtod(at, &end);
+        if (end == at) break;
+        values[count++] = value;
+        at = end;
+        while (*at == ' ' || *at == ',' || *at == '\n' || *at == '\r' || *at == '\t') at++;
+    }
+    return count;
+}
+
+/**
+ * @brief Reads one metric of every benchmark of a run.
+ *
+ * @return true if the file was read and holds at least one benchmark.
+ */
+static bool readRun(const char* path, const char* metric, Run* run) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = malloc(size > 0 ? (size_t)size + 1 : 1);
+    bool ok = text && size > 0 && fread(text, 1, (size_t)size, file) == (size_t)size;
+    fclose(file);
+    if (!ok) {
+        free(text);
+        return false;
+    }
+    text[size] = '\0';
+
+    memset(run, 0, sizeof(*run));
+    if (readString(text, "config", run->config, sizeof(run->config)) == NULL) strcpy(run->config, "?");
+    const char* at = strstr(text, "\"benchmarks\"");
+    while (at && run->count < MAX_BENCHMARKS) {
+        Series* series = &run->series[run->count];
+        at = readString(at, "name", series->name, sizeof(series->name));
+        if (at == NULL) break;
+        const char* next = strstr(at, "\"name\"");
+        series->count = readArray(at, next, metric, series->samples, MAX_SAMPLES);
+        if (series->count > 0) run->count++;
+    }
+    free(text);
+    return run->count > 0;
+}
+
+/* -- Statistics ----------------------------------------------------------*/
+
+/**
+ * @brief Returns z such that a standard normal variable exceeds z with probability `tail`.
+ */
+static double normalQuantile(double tail) {
+    double low = 0.0, high = 40.0;
+    for (int i = 0; i < 100; i++) {
+        double middle = (low + high) / 2;
+        if (0.5 * erfc(middle / sqrt(2.0)) > tail) low = middle;
+        else high = middle;
+    }
+    return low;
+}
+
+/**
+ * @brief Estimates the ratio of the run to the baseline with a confidence interval of `1 - error`.
+ *
+ * @details
+ * This is the Hodges-Lehmann estimate of a shift in log scale. Under no change, the number of pairs
+ * whose ratio lies below the true ratio follows the Mann-Whitney distribution, with mean `nm / 2`
+ * and variance `nm (n + m + 1) / 12`, so the interval runs between the sorted pairwise ratios
+ * `z` standard deviations either side of the middle; with too few pairs it is unbounded. A zero
+ * baseline repetition gives a ratio of 1 against a zero run and of infinity against anything else.
+ */
+static Estimate estimate(const Series* base, const Series* run, double error) {
+    static double ratios[MAX_SAMPLES * MAX_SAMPLES];
+    size_t count = 0;
+    for (size_t i = 0; i < base->count; i++) {
+        for (size_t j = 0; j < run->count; j++) {
+            double b = base->samples[i], r = run->samples[j];
+            ratios[count++] = b != 0.0 ? r / b : (r == 0.0 ? 1.0 : INFINITY);
+        }
+    }
+    Estimate result;
+    result.ratio = benchMedian(ratios, count);
+    double spread = normalQuantile(error / 2) * sqrt(count * (base->count + run->count + 1) / 12.0);
+    double rank = floor(count / 2.0 - spread);
+    result.bounded = rank >= 0;
+    result.low = result.bounded ? ratios[(size_t)rank] : 0.0;
+    result.high = result.bounded ? ratios[count - 1 - (size_t)rank] : INFINITY;
+    return result;
+}
+
+static const Series* findSeries(const Run* run, const char* name) {
+    for (size_t i = 0; i < run->count; i++) {
+        if (strcmp(run->series[i].name, name) == 0) return &run->series[i];
+    }
+    return NULL;
+}
+
+/* -- Main ----------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+    const char* metric = DEFAULT_METRIC;
+    double threshold = DEFAULT_THRESHOLD;
+    const char* paths[2] = { NULL, NULL };
+    int path_count = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--metric") == 0 && i + 1 < argc) metric = argv[++i];
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) threshold = strtod(argv[++i], NULL);
+        else if (argv[i][0] != '-' && path_count < 2) paths[path_count++] = argv[i];
+        else path_count = 3;
+    }
+    if (path_count != 2) {
+        fprintf(stderr, "usage: %s [--metric NAME] [--threshold PERCENT] BASELINE RUN\n", argv[0]);
+        return 2;
+    }
+
+    static Run baseline;
+    static Run current;
+    if (!readRun(paths[0], metric, &baseline) || !readRun(paths[1], metric, &current)) {
+        fprintf(stderr, "could not read '%s' results from %s and %s\n", metric, paths[0], paths[1]);
+        return 2;
+    }
+    if (strcmp(baseline.config, current.config) != 0) {
+        fprintf(stderr, "warning: comparing %s against a baseline of %s\n", current.config, baseline.config);
+    }
+
+    // One interval per compared benchmark, corrected so that they hold jointly
+    size_t compared = 0;
+    for (size_t i = 0; i < baseline.count; i++) {
+        if (findSeries(&current, baseline.series[i].name) != NULL) compared++;
+    }
+    double error = FAMILY_ERROR / (compared > 0 ? compared : 1);
+
+    // Throughput is better when higher, latencies and failures when lower
+    bool higher_is_better = strcmp(metric, "mops") == 0;
+    double worse_ratio = higher_is_better ? 1.0 - threshold / 100 : 1.0 + threshold / 100;
+    double better_ratio = higher_is_better ? 1.0 + threshold / 100 : 1.0 - threshold / 100;
+    int slower = 0;
+    bool unbounded = false;
+    printf("%-16s %12s %12s %8s %19s  %s\n", "benchmark", "baseline", "run", "change", "interval", metric);
+    for (size_t i = 0; i < baseline.count; i++) {
+        Series* base_series = &baseline.series[i];
+        const Series* found = findSeries(&current, base_series->name);
+        if (found == NULL) {
+            printf("%-16s %12s %12s %8s %19s  missing from run\n", base_series->name, "", "", "", "");
+            continue;
+        }
+        Series run_series = *found;
+        Estimate estimated = estimate(base_series, &run_series, error);
+        unbounded |= !estimated.bounded;
+        // Slower only if even the best end of the interval is worse than the threshold, and vice versa
+        double best = higher_is_better ? estimated.high : estimated.low;
+        double worst = higher_is_better ? estimated.low : estimated.high;
+        bool beyond_worse = higher_is_better ? estimated.ratio < worse_ratio : estimated.ratio > worse_ratio;
+        bool beyond_better = higher_is_better ? estimated.ratio > better_ratio : estimated.ratio < better_ratio;
+        const char* verdict = "ok";
+        if (higher_is_better ? best < worse_ratio : best > worse_ratio) {
+            verdict = "SLOWER";
+            slower++;
+        } else if (higher_is_better ? worst > better_ratio : worst < better_ratio) {
+            verdict = "faster";
+        } else if (beyond_worse || beyond_better) {
+            verdict = "ok (within noise)";
+        }
+        char interval[32];
+        snprintf(interval, sizeof(interval), "[%+.1f%%, %+.1f%%]",
+                 100.0 * (estimated.low - 1), 100.0 * (estimated.high - 1));
+        double base_median = benchMedian(base_series->samples, base_series->count);
+        double run_median = benchMedian(run_series.samples, run_series.count);
+        printf("%-16s %12.3f %12.3f %+7.1f%% %19s  %s\n", base_series->name, base_median, run_median,
+               100.0 * (estimated.ratio - 1), interval, verdict);
+    }
+    printf("intervals of %.2f%% each, 95%% jointly over %zu benchmarks\n", 100.0 * (1 - error), compared);
+    if (unbounded) {
+        printf("warning: too few repetitions for these intervals, so they are unbounded; "
+               "pass a larger --repeat\n");
+    }
+    if (slower > 0) {
+        printf("%d benchmark(s) slower than the baseline by more than %.1f%%\n", slower, threshold);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file trace_file.h
+ *
+ * @brief This is the on-disk format of allocation traces, shared by the trace tools.
+ *
+ * @details
+ * A trace file is a `TraceFileHeader` followed by `count` `TraceRecord`s, both in the byte order of
+ * the machine that wrote them. The header keeps the pool geometry of the recording, so a replay can
+ * map the recorded block indices back to allocations.
+ *
+ * - traceWriteFile: Writes a trace, unwrapping an allocator's ring buffer into chronological order.
+ * - traceReadFile: Reads a trace into a buffer from `malloc`.
+ */
+#ifndef _TRACE_FILE_H_
+#define _TRACE_FILE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "allocator.h"
+
+/* -- Defines -------------------------------------------------------------*/
+
+#define TRACE_FILE_MAGIC 0x4543415254434C41ull   // "ALCTRACE" read as a little-endian word
+#define TRACE_FILE_VERSION 1
+
+typedef struct {
+    uint64_t magic;         ///< `TRACE_FILE_MAGIC`.
+    uint32_t version;       ///< `TRACE_FILE_VERSION`.
+    uint32_t block_size;    ///< Block size of the recorded pool, in bytes.
+    uint64_t pool_size;     ///< Size of the recorded pool, in bytes.
+    uint64_t count;         ///< Number of records following the header.
+    uint64_t lost;          ///< Records overwritten in the ring buffer before the trace was saved.
+} TraceFileHeader;
+
+/* -- Functions -----------------------------------------------------------*/
+
+/**
+ * @brief Writes a trace to a file.
+ *
+ * @param path The file to write.
+ * @param header The header to write; `count` and `lost` are filled in here.
+ * @param records The ring buffer holding the trace.
+ * @param capacity The number of records the ring buffer holds.
+ * @param written The number of records written to the ring buffer, wrapping included.
+ * @return true if the whole trace was written.
+ */
+static inline bool traceWriteFile(const char* path, TraceFileHeader* header, const TraceRecord* records, uint64_t capacity, uint64_t written) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) return false;
+    header->magic = TRACE_FILE_MAGIC;
+    header->version = TRACE_FILE_VERSION;
+    header->count = (written < capacity) ? written : capacity;
+    header->lost = written - header->count;
+    bool ok = fwrite(header, sizeof(*header), 1, file) == 1;
+    // The oldest surviving record sits where the next one would be written
+    uint64_t first = (written < capacity) ? 0 : written % capacity;
+    for (uint64_t i = 0; ok && i < header->count; i++) {
+        ok = fwrite(&records[(first + i) % capacity], sizeof(TraceRecord), 1, file) == 1;
+    }
+    return (fclose(file) == 0) && ok;
+}
+
+/**
+ * @brief Reads a trace from a file.
+ *
+ * @param path The file to read.
+ * @param header Receives the header of the trace.
+ * @return The records, to be released with `free`, or NULL if the file is not a valid trace.
+ */
+static inline TraceRecord* traceReadFile(const char* path, TraceFileHeader* header) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+    TraceRecord* records = NULL;
+    if (fread(header, sizeof(*header), 1, file) == 1 && header->magic == TRACE_FILE_MAGIC
+        && header->version == TRACE_FILE_VERSION && header->block_size > 0) {
+        records = malloc((header->count ? header->count : 1) * sizeof(TraceRecord));
+        if (records && fread(records, sizeof(TraceRecord), header->count, file) != header->count) {
+            free(records);
+            records = NULL;
+        }
+    }
+    fclose(file);
+    return records;
+}
+
+#endif // _TRACE_FILE_H_
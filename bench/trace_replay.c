@@ -0,0 +1,287 @@
+/**
+ * @file trace_replay.c
+ *
+ * @brief Replays a recorded allocation trace and reports how the allocator handled it.
+ *
+ * @details
+ * A trace is recorded by an allocator built with `ALLOCATION_TRACE`, whose ring buffer is saved with
+ * `traceWriteFile`. The replay issues the same sequence of `allocate`/`deallocate` calls on a fresh
+ * pool, using the recorded block index of each allocation to find the pointer to deallocate later.
+ * The block size and pool size default to those of the recording and can be overridden, so one
+ * trace can be compared across geometries and across builds with other `MAPSIZE`/`INDEXSIZE`.
+ *
+ * The trace is replayed twice: once untimed per call to measure throughput, and once timing each
+ * call to measure latency. Requests that failed in the recording are replayed too; if they succeed
+ * in the replay, they are deallocated at once, untimed, since the trace never frees them. The peak
+ * usage is the high water mark of allocated blocks.
+ *
+ * Usage:
+ *   trace_replay.bench [--header] [--block-size B] [--pool-bytes P] TRACE
+ *   trace_replay.bench --synthesize N [--seed S] TRACE   (needs `ALLOCATION_TRACE`)
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "bench_utils.h"
+#include "trace_file.h"
+
+/* -- Defines -------------------------------------------------------------*/
+
+#define DEFAULT_SEED 0x9E3779B97F4A7C15ull
+#define SYNTHETIC_BLOCK_SIZE 8
+#define SYNTHETIC_POOL_SIZE 32768
+#define SYNTHETIC_MAX_LIVE 512
+
+typedef struct {
+    double mops;                ///< Millions of replayed calls per second.
+    uint64_t alloc_p50;         ///< Median `allocate` latency in nanoseconds.
+    uint64_t alloc_p99;         ///< 99th percentile `allocate` latency in nanoseconds.
+    uint64_t alloc_p999;        ///< 99.9th percentile `allocate` latency in nanoseconds.
+    uint64_t free_p50;          ///< Median `deallocate` latency in nanoseconds.
+    uint64_t free_p99;          ///< 99th percentile `deallocate` latency in nanoseconds.
+    uint64_t free_p999;         ///< 99.9th percentile `deallocate` latency in nanoseconds.
+    uint64_t peak_bytes;        ///< Most bytes allocated at once.
+    uint64_t failures;          ///< Allocations that returned NULL in the replay.
+    uint64_t recorded_failures; ///< Allocations that returned NULL in the recording.
+} Result;
+
+/* -- Replay --------------------------------------------------------------*/
+
+typedef struct {
+    Allocator allocator;
+    void* metadata;
+    void* memory;
+    indexSize_t metadata_size;
+    indexSize_t size;
+    void** live;            ///< Replayed allocation of each recorded head block, or NULL.
+    uint64_t recorded_blocks;
+} Replay;
+
+/**
+ * @brief Creates the pool and index map of a replay.
+ *
+ * @return true if the pool fits the index type and memory could be reserved.
+ */
+static bool replayInit(Replay* replay, const TraceFileHeader* header, uint64_t block_size, uint64_t pool_size) {
+    memset(replay, 0, sizeof(*replay));
+    if (pool_size > INDEXSIZE_MAX || block_size > INDEXSIZE_MAX || block_size == 0) return false;
+    replay->size = (indexSize_t)pool_size;
+    replay->metadata_size = allocatorMetadataSize((indexSize_t)block_size, replay->size);
+    replay->recorded_blocks = header->pool_size / header->block_size;
+    replay->metadata = malloc(replay->metadata_size);
+    replay->memory = malloc(replay->size);
+    replay->live = malloc((replay->recorded_blocks ? replay->recorded_blocks : 1) * sizeof(void*));
+    if (!replay->metadata || !replay->memory || !replay->live) {
+        free(replay->metadata);
+        free(replay->memory);
+        free(replay->live);
+        return false;
+    }
+    replay->allocator.block_size = (indexSize_t)block_size;
+    return true;
+}
+
+/**
+ * @brief Empties the pool and index map before a pass.
+ */
+static void replayReset(Replay* replay) {
+    indexSize_t block_size = replay->allocator.block_size;
+    memset(replay->metadata, 0, replay->metadata_size);
+    memset(replay->live, 0, replay->recorded_blocks * sizeof(void*));
+    initAllocatorExternal(&replay->allocator, block_size, replay->metadata, replay->metadata_size, replay->memory, replay->size);
+}
+
+static void replayFree(Replay* replay) {
+    free(replay->metadata);
+    free(replay->memory);
+    free(replay->live);
+}
+
+/**
+ * @brief Replays one recorded call.
+ *
+ * @param alloc_ns Receives the latency of an allocation, or NULL to skip timing.
+ * @param free_ns Receives the latency of a deallocation, or NULL to skip timing.
+ * @return The operation that was timed, or 0 if the record was skipped.
+ */
+static int replayRecord(Replay* replay, const TraceRecord* record, uint64_t* alloc_ns, uint64_t* free_ns, Result* result) {
+    TraceOp op = TRACE_RECORD_OP(record);
+    uint64_t before = 0;
+    if (op == TRACE_DEALLOCATE) {
+        if (record->index >= replay->recorded_blocks || replay->live[record->index] == NULL) return 0;
+        if (free_ns) before = benchNow();
+        deallocate(&replay->allocator, replay->live[record->index]);
+        if (free_ns) *free_ns = benchNow() - before;
+        replay->live[record->index] = NULL;
+        return TRACE_DEALLOCATE;
+    }
+    if (op != TRACE_ALLOCATE && op != TRACE_FAILED) return 0;
+    if (alloc_ns) before = benchNow();
+    void* block = allocate(&replay->allocator, (indexSize_t)record->size);
+    if (alloc_ns) *alloc_ns = benchNow() - before;
+    if (block == NULL) {
+        result->failures++;
+    } else if (op == TRACE_FAILED || record->index >= replay->recorded_blocks) {
+        deallocate(&replay->allocator, block);
+    } else {
+        replay->live[record->index] = block;
+    }
+    return TRACE_ALLOCATE;
+}
+
+/**
+ * @brief Replays a trace for throughput, then again for latency.
+ */
+static void runReplay(Replay* replay, const TraceRecord* records, uint64_t count, Result* result) {
+    memset(result, 0, sizeof(*result));
+    for (uint64_t i = 0; i < count; i++) {
+        if (TRACE_RECORD_OP(&records[i]) == TRACE_FAILED) result->recorded_failures++;
+    }
+
+    // Throughput: untimed calls
+    replayReset(replay);
+    uint64_t calls = 0;
+    uint64_t start = benchNow();
+    for (uint64_t i = 0; i < count; i++) {
+        if (replayRecord(replay, &records[i], NULL, NULL, result)) calls++;
+    }
+    uint64_t elapsed = benchNow() - start;
+    result->mops = elapsed ? (calls * 1000.0) / (double)elapsed : 0.0;
+    result->peak_bytes = (uint64_t)replay->allocator.stats.high_water_blocks * replay->allocator.block_size;
+
+    // Latency: every call timed, failures counted once
+    uint64_t* alloc_ns = malloc((count ? count : 1) * sizeof(uint64_t));
+    uint64_t* free_ns = malloc((count ? count : 1) * sizeof(uint64_t));
+    size_t allocs = 0;
+    size_t frees = 0;
+    Result timed = { 0 };
+    replayReset(replay);
+    for (uint64_t i = 0; i < count; i++) {
+        switch (replayRecord(replay, &records[i], &alloc_ns[allocs], &free_ns[frees], &timed)) {
+        case TRACE_ALLOCATE: allocs++; break;
+        case TRACE_DEALLOCATE: frees++; break;
+        default: break;
+        }
+    }
+    result->alloc_p50 = benchPercentile(alloc_ns, allocs, 500);
+    result->alloc_p99 = benchPercentile(alloc_ns, allocs, 990);
+    result->alloc_p999 = benchPercentile(alloc_ns, allocs, 999);
+    result->free_p50 = benchPercentile(free_ns, frees, 500);
+    result->free_p99 = benchPercentile(free_ns, frees, 990);
+    result->free_p999 = benchPercentile(free_ns, frees, 999);
+    free(alloc_ns);
+    free(free_ns);
+}
+
+/* -- Synthesis -----------------------------------------------------------*/
+
+#ifdef ALLOCATION_TRACE
+/**
+ * @brief Records a random mix of allocations and deallocations into a trace file.
+ *
+ * @return 0 on success, or 1 if the trace could not be written.
+ */
+static int synthesize(const char* path, uint64_t count, uint64_t seed) {
+    static uint8_t memory[SYNTHETIC_POOL_SIZE];
+    void* live[SYNTHETIC_MAX_LIVE];
+    size_t live_count = 0;
+    Allocator allocator;
+    TraceRecord* records = malloc(count * sizeof(TraceRecord));
+    if (records == NULL) return 1;
+    initAllocator(&allocator, SYNTHETIC_BLOCK_SIZE, memory, SYNTHETIC_POOL_SIZE);
+    setTraceBuffer(&allocator, records, count);
+
+    while (allocator.trace.written < count) {
+        // Grow the live set while it is small, shrink it while it is large
+        bool grow = live_count == 0 || (live_count < SYNTHETIC_MAX_LIVE && benchRange(&seed, 0, SYNTHETIC_MAX_LIVE) >= live_count);
+        if (grow) {
+            void* block = allocate(&allocator, (indexSize_t)benchRange(&seed, 1, 64));
+            if (block) live[live_count++] = block;
+        } else {
+            size_t slot = benchRandom(&seed) % live_count;
+            deallocate(&allocator, live[slot]);
+            live[slot] = live[--live_count];
+        }
+    }
+
+    TraceFileHeader header = { .block_size = SYNTHETIC_BLOCK_SIZE, .pool_size = SYNTHETIC_POOL_SIZE };
+    bool ok = traceWriteFile(path, &header, records, allocator.trace.capacity, allocator.trace.written);
+    free(records);
+    if (!ok) fprintf(stderr, "could not write %s\n", path);
+    return ok ? 0 : 1;
+}
+#endif
+
+/* -- Main ----------------------------------------------------------------*/
+
+static int usage(const char* name) {
+    fprintf(stderr, "usage: %s [--header] [--block-size B] [--pool-bytes P] TRACE\n"
+                    "       %s --synthesize N [--seed S] TRACE\n", name, name);
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    bool header_row = false;
+    uint64_t block_size = 0;
+    uint64_t pool_size = 0;
+    uint64_t synthetic = 0;
+    uint64_t seed = DEFAULT_SEED;
+    const char* path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--header") == 0) header_row = true;
+        else if (strcmp(argv[i], "--block-size") == 0 && i + 1 < argc) block_size = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--pool-bytes") == 0 && i + 1 < argc) pool_size = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--synthesize") == 0 && i + 1 < argc) synthetic = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 0);
+        else if (argv[i][0] != '-' && path == NULL) path = argv[i];
+        else return usage(argv[0]);
+    }
+    if (path == NULL || seed == 0) return usage(argv[0]);
+
+    if (synthetic > 0) {
+#ifdef ALLOCATION_TRACE
+        return synthesize(path, synthetic, seed);
+#else
+        fprintf(stderr, "--synthesize needs a build with FEATURES=ALLOCATION_TRACE\n");
+        return 2;
+#endif
+    }
+
+    TraceFileHeader header;
+    TraceRecord* records = traceReadFile(path, &header);
+    if (records == NULL) {
+        fprintf(stderr, "%s is not a readable trace\n", path);
+        return 1;
+    }
+    if (block_size == 0) block_size = header.block_size;
+    if (pool_size == 0) pool_size = header.pool_size;
+
+    Replay replay;
+    if (!replayInit(&replay, &header, block_size, pool_size)) {
+        fprintf(stderr, "a pool of %llu bytes in blocks of %llu does not fit this build\n",
+                (unsigned long long)pool_size, (unsigned long long)block_size);
+        free(records);
+        return 1;
+    }
+    Result result;
+    runReplay(&replay, records, header.count, &result);
+
+    if (header_row) {
+        printf("%-14s %9s %6s %10s %9s %9s %9s %9s %9s %9s %9s %10s %8s %8s\n",
+               "config", "records", "block", "pool", "Mops/s", "alloc p50", "alloc p99", "alloc p999",
+               "free p50", "free p99", "free p999", "peak", "failed", "rec fail");
+    }
+    printf("%-14s %9llu %6llu %10llu %9.2f %7lluns %7lluns %8lluns %7lluns %7lluns %7lluns %10llu %8llu %8llu\n",
+           BENCH_CONFIG, (unsigned long long)header.count, (unsigned long long)block_size, (unsigned long long)pool_size,
+           result.mops, (unsigned long long)result.alloc_p50, (unsigned long long)result.alloc_p99,
+           (unsigned long long)result.alloc_p999, (unsigned long long)result.free_p50,
+           (unsigned long long)result.free_p99, (unsigned long long)result.free_p999,
+           (unsigned long long)result.peak_bytes, (unsigned long long)result.failures,
+           (unsigned long long)result.recorded_failures);
+    if (header.lost > 0) fprintf(stderr, "warning: %llu records were lost before the trace was saved\n", (unsigned long long)header.lost);
+
+    replayFree(&replay);
+    free(records);
+    return 0;
+}
@@ -0,0 +1,250 @@
+#include "workload.h"
+#include "bench_utils.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* -- Presets ------------------------------------------------------------ */
+
+const WorkloadConfig workload_presets[] = {
+    {
+        .name = "zipf-exp", .pattern = WORKLOAD_STEADY, .max_live = 1024,
+        .size_kind = WORKLOAD_SIZE_ZIPF, .min_size = 8, .max_size = 1024, .zipf_exponent = 1.1,
+        .lifetime_kind = WORKLOAD_LIFETIME_EXPONENTIAL, .short_mean = 256,
+    },
+    {
+        .name = "lognorm-bimodal", .pattern = WORKLOAD_STEADY, .max_live = 1024,
+        .size_kind = WORKLOAD_SIZE_LOGNORMAL, .min_size = 8, .max_size = 2048, .median_size = 48, .sigma = 1.0,
+        .lifetime_kind = WORKLOAD_LIFETIME_BIMODAL, .short_mean = 16, .long_mean = 4096, .short_per_mille = 900,
+    },
+    {
+        .name = "prodcons", .pattern = WORKLOAD_PRODUCER_CONSUMER, .max_live = 1024,
+        .size_kind = WORKLOAD_SIZE_UNIFORM, .min_size = 16, .max_size = 256,
+        .phase_ops = 4096, .produce_per_mille = 700,
+    },
+    {
+        .name = "burst-drain", .pattern = WORKLOAD_BURST_DRAIN, .max_live = 1024,
+        .size_kind = WORKLOAD_SIZE_LOGNORMAL, .min_size = 8, .max_size = 1024, .median_size = 64, .sigma = 0.7,
+        .burst_size = 512, .drain_per_mille = 750,
+    },
+};
+
+const size_t workload_preset_count = sizeof(workload_presets) / sizeof(workload_presets[0]);
+
+/* -- Private Function Declarations --------------------------------------- */
+
+/**
+ * @brief Draws a value spread evenly over (0, 1].
+ */
+static double drawUnit(Workload* workload);
+
+/**
+ * @brief Draws an allocation size from the configured distribution.
+ */
+static uint32_t drawSize(Workload* workload);
+
+/**
+ * @brief Draws a lifetime, in allocations, from the configured distribution.
+ */
+static uint64_t drawLifetime(Workload* workload);
+
+/**
+ * @brief Adds a live allocation to the heap.
+ */
+static void heapPush(Workload* workload, uint64_t key, uint32_t slot);
+
+/**
+ * @brief Removes the live allocation with the smallest key from the heap.
+ *
+ * @return The slot of the allocation.
+ */
+static uint32_t heapPop(Workload* workload);
+
+/**
+ * @brief Generates an allocation into an unused slot, freed in the order of `key`.
+ */
+static void emitAllocate(Workload* workload, WorkloadOp* op, uint64_t key, uint32_t size);
+
+/**
+ * @brief Generates the deallocation of the live allocation with the smallest key.
+ */
+static void emitDeallocate(Workload* workload, WorkloadOp* op);
+
+/* -- Public Functions----------------------------------------------------- */
+
+bool workloadInit(Workload* workload, const WorkloadConfig* config, uint64_t seed) {
+    *workload = (Workload){ .config = config, .seed = seed, .burst_left = config->burst_size };
+    workload->heap = malloc(config->max_live * sizeof(WorkloadEntry));
+    workload->free_slots = malloc(config->max_live * sizeof(uint32_t));
+    if (config->size_kind == WORKLOAD_SIZE_ZIPF) {
+        uint32_t sizes = config->max_size - config->min_size + 1;
+        workload->zipf_cdf = malloc(sizes * sizeof(double));
+        if (workload->zipf_cdf) {
+            double sum = 0.0;
+            for (uint32_t rank = 0; rank < sizes; rank++) {
+                sum += 1.0 / pow(rank + 1, config->zipf_exponent);
+                workload->zipf_cdf[rank] = sum;
+            }
+            for (uint32_t rank = 0; rank < sizes; rank++) workload->zipf_cdf[rank] /= sum;
+        }
+    }
+    if (!workload->heap || !workload->free_slots || (config->size_kind == WORKLOAD_SIZE_ZIPF && !workload->zipf_cdf)) {
+        workloadFree(workload);
+        return false;
+    }
+    // Hand out the lowest slots first
+    for (uint32_t slot = 0; slot < config->max_live; slot++) {
+        workload->free_slots[slot] = config->max_live - 1 - slot;
+    }
+    workload->free_count = config->max_live;
+    return true;
+}
+
+void workloadNext(Workload* workload, WorkloadOp* op) {
+    const WorkloadConfig* config = workload->config;
+    workload->step++;
+    switch (config->pattern) {
+    case WORKLOAD_PRODUCER_CONSUMER: {
+        // The producer is faster in even phases, the consumer in odd ones
+        bool producer_phase = ((workload->step / config->phase_ops) & 1) == 0;
+        uint32_t produce = producer_phase ? config->produce_per_mille : 1000 - config->produce_per_mille;
+        bool full = workload->live == config->max_live;
+        if (workload->live == 0 || (!full && benchRange(&workload->seed, 0, 999) < produce)) {
+            emitAllocate(workload, op, workload->now, drawSize(workload));
+        } else {
+            emitDeallocate(workload, op);
+        }
+        break;
+    }
+    case WORKLOAD_BURST_DRAIN:
+        if (!workload->draining && (workload->burst_left == 0 || workload->live == config->max_live)) {
+            workload->draining = true;
+            workload->drain_target = workload->live - (uint32_t)((uint64_t)workload->live * config->drain_per_mille / 1000);
+            // Always make room for the next burst
+            if (workload->drain_target == config->max_live) workload->drain_target--;
+        }
+        if (workload->draining && workload->live > workload->drain_target) {
+            emitDeallocate(workload, op);
+            break;
+        }
+        if (workload->draining) {
+            workload->draining = false;
+            workload->burst_left = config->burst_size;
+        }
+        workload->burst_left--;
+        // Random keys free the drained allocations in random order
+        emitAllocate(workload, op, benchRandom(&workload->seed), drawSize(workload));
+        break;
+    default:
+        // Free what is due, then allocate; when full, free the next due early
+        if (workload->live > 0 && (workload->heap[0].key <= workload->now || workload->live == config->max_live)) {
+            emitDeallocate(workload, op);
+        } else {
+            uint32_t size = drawSize(workload);
+            emitAllocate(workload, op, workload->now + drawLifetime(workload), size);
+        }
+        break;
+    }
+}
+
+const WorkloadConfig* workloadFind(const char* name) {
+    for (size_t i = 0; i < workload_preset_count; i++) {
+        if (strcmp(workload_presets[i].name, name) == 0) return &workload_presets[i];
+    }
+    return NULL;
+}
+
+void workloadFree(Workload* workload) {
+    free(workload->heap);
+    free(workload->free_slots);
+    free(workload->zipf_cdf);
+    workload->heap = NULL;
+    workload->free_slots = NULL;
+    workload->zipf_cdf = NULL;
+}
+
+/* -- Private Functions --------------------------------------------------- */
+
+static double drawUnit(Workload* workload) {
+    return ((benchRandom(&workload->seed) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+static uint32_t drawSize(Workload* workload) {
+    const WorkloadConfig* config = workload->config;
+    switch (config->size_kind) {
+    case WORKLOAD_SIZE_ZIPF: {
+        // Binary search for the first rank whose cumulative probability reaches the draw
+        double unit = drawUnit(workload);
+        uint32_t low = 0;
+        uint32_t high = config->max_size - config->min_size;
+        while (low < high) {
+            uint32_t middle = low + (high - low) / 2;
+            if (workload->zipf_cdf[middle] < unit) low = middle + 1; else high = middle;
+        }
+        return config->min_size + low;
+    }
+    case WORKLOAD_SIZE_LOGNORMAL: {
+        // Box-Muller transform of two uniform draws into a standard normal draw
+        double normal = sqrt(-2.0 * log(drawUnit(workload))) * cos(2.0 * M_PI * drawUnit(workload));
+        double size = exp(log(config->median_size) + config->sigma * normal);
+        if (size < config->min_size) return config->min_size;
+        if (size > config->max_size) return config->max_size;
+        return (uint32_t)size;
+    }
+    default:
+        return (uint32_t)benchRange(&workload->seed, config->min_size, config->max_size);
+    }
+}
+
+static uint64_t drawLifetime(Workload* workload) {
+    const WorkloadConfig* config = workload->config;
+    double mean = config->short_mean;
+    if (config->lifetime_kind == WORKLOAD_LIFETIME_BIMODAL && benchRange(&workload->seed, 0, 999) >= config->short_per_mille) {
+        mean = config->long_mean;
+    }
+    return 1 + (uint64_t)(-mean * log(drawUnit(workload)));
+}
+
+static void heapPush(Workload* workload, uint64_t key, uint32_t slot) {
+    WorkloadEntry* heap = workload->heap;
+    uint32_t index = workload->live++;
+    while (index > 0 && heap[(index - 1) / 2].key > key) {
+        heap[index] = heap[(index - 1) / 2];
+        index = (index - 1) / 2;
+    }
+    heap[index] = (WorkloadEntry){ .key = key, .slot = slot };
+}
+
+static uint32_t heapPop(Workload* workload) {
+    WorkloadEntry* heap = workload->heap;
+    uint32_t slot = heap[0].slot;
+    WorkloadEntry last = heap[--workload->live];
+    uint32_t index = 0;
+    for (;;) {
+        uint32_t child = 2 * index + 1;
+        if (child >= workload->live) break;
+        if (child + 1 < workload->live && heap[child + 1].key < heap[child].key) child++;
+        if (heap[child].key >= last.key) break;
+        heap[index] = heap[child];
+        index = child;
+    }
+    heap[index] = last;
+    return slot;
+}
+
+static void emitAllocate(Workload* workload, WorkloadOp* op, uint64_t key, uint32_t size) {
+    uint32_t slot = workload->free_slots[--workload->free_count];
+    heapPush(workload, key, slot);
+    workload->now++;
+    *op = (WorkloadOp){ .kind = WORKLOAD_ALLOCATE, .slot = slot, .size = size };
+}
+
+static void emitDeallocate(Workload* workload, WorkloadOp* op) {
+    uint32_t slot = heapPop(workload);
+    workload->free_slots[workload->free_count++] = slot;
+    *op = (WorkloadOp){ .kind = WORKLOAD_DEALLOCATE, .slot = slot, .size = 0 };
+}
@@ -0,0 +1,147 @@
+/**
+ * @file workload.h
+ *
+ * @brief This is a generator of synthetic allocation workloads for the benchmarks.
+ *
+ * @details
+ * A workload is a stream of operations: allocate a size into a slot, or deallocate the allocation
+ * held by a slot. The generator only tracks slots, so a harness keeps one pointer per slot and can
+ * drive any allocator with the stream. The stream depends on nothing but the configuration and the
+ * seed, so a run can be reproduced exactly, and an allocation that fails in the harness leaves its
+ * slot empty without changing what comes next.
+ *
+ * Sizes are drawn from one of:
+ *
+ * - WORKLOAD_SIZE_UNIFORM: Every size in [min_size, max_size] equally likely.
+ * - WORKLOAD_SIZE_ZIPF: Size `min_size + k - 1` with a probability proportional to `1 / k^s`.
+ * - WORKLOAD_SIZE_LOGNORMAL: `exp(N(ln median, sigma))`, clamped to [min_size, max_size].
+ *
+ * Allocations are released according to one of:
+ *
+ * - WORKLOAD_STEADY: Each allocation lives for a lifetime drawn from an exponential or a bimodal
+ *   distribution, counted in allocations.
+ * - WORKLOAD_PRODUCER_CONSUMER: A queue, freed oldest first, whose producer and consumer take turns
+ *   being faster, so the queue repeatedly grows and shrinks.
+ * - WORKLOAD_BURST_DRAIN: Bursts of allocations, each followed by a drain that frees a share of the
+ *   live allocations in random order.
+ */
+#ifndef _WORKLOAD_H_
+#define _WORKLOAD_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* -- Types ---------------------------------------------------------------*/
+
+typedef enum {
+    WORKLOAD_SIZE_UNIFORM,
+    WORKLOAD_SIZE_ZIPF,
+    WORKLOAD_SIZE_LOGNORMAL,
+} WorkloadSizeKind;
+
+typedef enum {
+    WORKLOAD_LIFETIME_EXPONENTIAL,  ///< Exponential with mean `short_mean`.
+    WORKLOAD_LIFETIME_BIMODAL,      ///< Exponential with mean `short_mean` or `long_mean`.
+} WorkloadLifetimeKind;
+
+typedef enum {
+    WORKLOAD_STEADY,
+    WORKLOAD_PRODUCER_CONSUMER,
+    WORKLOAD_BURST_DRAIN,
+} WorkloadPattern;
+
+typedef struct {
+    const char* name;               ///< Name printed by the harness.
+    WorkloadPattern pattern;
+    uint32_t max_live;              ///< Most allocations live at once; the oldest due is freed early beyond it.
+
+    WorkloadSizeKind size_kind;
+    uint32_t min_size;              ///< Smallest size, in bytes.
+    uint32_t max_size;              ///< Largest size, in bytes.
+    double zipf_exponent;           ///< `s` of the Zipf distribution.
+    double median_size;             ///< Median of the log-normal distribution, in bytes.
+    double sigma;                   ///< Standard deviation of the log-normal distribution, in log space.
+
+    WorkloadLifetimeKind lifetime_kind;
+    double short_mean;              ///< Mean lifetime, or mean of the short lifetimes, in allocations.
+    double long_mean;               ///< Mean of the long lifetimes, in allocations.
+    uint32_t short_per_mille;       ///< Share of short lifetimes in the bimodal distribution.
+
+    uint32_t phase_ops;             ///< Operations per producer/consumer phase.
+    uint32_t produce_per_mille;     ///< Chance of producing in the producer's phase; the complement in the consumer's.
+    uint32_t burst_size;            ///< Allocations per burst.
+    uint32_t drain_per_mille;       ///< Share of the live allocations freed by each drain.
+} WorkloadConfig;
+
+typedef enum {
+    WORKLOAD_ALLOCATE,
+    WORKLOAD_DEALLOCATE,
+} WorkloadOpKind;
+
+typedef struct {
+    WorkloadOpKind kind;
+    uint32_t slot;                  ///< Slot receiving or releasing the allocation, below `max_live`.
+    uint32_t size;                  ///< Size to allocate, in bytes.
+} WorkloadOp;
+
+typedef struct {
+    uint64_t key;                   ///< Order in which live allocations are freed, smallest first.
+    uint32_t slot;
+} WorkloadEntry;
+
+typedef struct {
+    const WorkloadConfig* config;
+    uint64_t seed;
+    uint64_t now;                   ///< Allocations generated so far.
+    uint64_t step;                  ///< Operations generated so far.
+    WorkloadEntry* heap;            ///< Live allocations, a min-heap on `key`.
+    uint32_t live;
+    uint32_t* free_slots;           ///< Stack of unused slots.
+    uint32_t free_count;
+    double* zipf_cdf;               ///< Cumulative Zipf probabilities, one per size.
+    bool draining;
+    uint32_t burst_left;
+    uint32_t drain_target;
+} Workload;
+
+/* -- Presets -------------------------------------------------------------*/
+
+// Workloads shared by the benchmarks: zipf-exp, lognorm-bimodal, prodcons and burst-drain
+extern const WorkloadConfig workload_presets[];
+extern const size_t workload_preset_count;
+
+/* -- Functions -----------------------------------------------------------*/
+
+/**
+ * @brief Prepares a generator.
+ *
+ * @param workload The generator to prepare.
+ * @param config The workload to generate, which must outlive the generator.
+ * @param seed The seed of the stream, which must not be zero.
+ * @return true on success, or false if memory could not be reserved.
+ */
+bool workloadInit(Workload* workload, const WorkloadConfig* config, uint64_t seed);
+
+/**
+ * @brief Generates the next operation of the stream.
+ *
+ * @param workload The generator.
+ * @param op Receives the operation.
+ */
+void workloadNext(Workload* workload, WorkloadOp* op);
+
+/**
+ * @brief Looks up a preset workload by name.
+ *
+ * @param name The name of the preset.
+ * @return The preset, or NULL if there is none of that name.
+ */
+const WorkloadConfig* workloadFind(const char* name);
+
+/**
+ * @brief Releases the memory of a generator.
+ */
+void workloadFree(Workload* workload);
+
+#endif // _WORKLOAD_H_
@@ -4,7 +4,23 @@
 
 // recreation of private function for test purposes
 bool get_bit(mapSize_t* bitmap, indexSize_t index) {
-    return (bitmap[index / MAPSIZE] & (1ULL << (index % MAPSIZE))) != 0;
+    return (bitmap[(index / MAPSIZE) * MAP_STRIDE] & (1ULL << (index % MAPSIZE))) != 0;
+}
+
+// memory needed per 1 byte block, including its side table entries and any extra bitmaps
+#ifdef RUN_LENGTHS
+#define POOL_SCALE (int)(1 + sizeof(runLength_t) + (BITMAP_COUNT > 3))
+#else
+#define POOL_SCALE (1 + (BITMAP_COUNT > 3))
+#endif
+
+// recreation of private function for test purposes
+indexSize_t metadata_size(indexSize_t map_words) {
+    indexSize_t size = map_words * BITMAP_COUNT * sizeof(mapSize_t);
+#ifdef RUN_LENGTHS
+    size += map_words * MAPSIZE * sizeof(runLength_t);
+#endif
+    return size;
 }
 
 void testInitAllocator(void) {
@@ -14,13 +30,17 @@ void testInitAllocator(void) {
         uint8_t memory[128];
         initAllocator(&allocator, 16, memory, 128);
 
+#ifndef RUN_LENGTHS
         ASSERT_EQUAL_INT(allocator.memory.size, 128 - 16, "incorrect size after initialization");
-        ASSERT_EQUAL_INT(allocator.block_size, 16, "incorrect block size after initialization");
         ASSERT_EQUAL_INT(allocator.bitmaps.size, 7, "incorrect bitmap size after initialization"); 
+#endif
+        ASSERT_EQUAL_INT(allocator.block_size, 16, "incorrect block size after initialization");
 
         ASSERT_EQUAL_PTR((uint8_t*)(allocator.bitmaps.used), memory, "heads bitmap placement is wrong"); 
         ASSERT_EQUAL_PTR((uint8_t*)(allocator.bitmaps.heads), memory + sizeof(mapSize_t), "used bitmap placement is wrong");  
-        ASSERT_EQUAL_PTR((uint8_t*)(allocator.memory.head), memory + 2 * sizeof(mapSize_t), "heads bitmap placement is wrong"); 
+#ifndef RUN_LENGTHS
+        ASSERT_EQUAL_PTR((uint8_t*)(allocator.memory.head), memory + ((BITMAP_COUNT + 1) & ~1) * sizeof(mapSize_t), "heads bitmap placement is wrong"); 
+#endif
 
     } CASE_COMPLETE;
 
@@ -37,6 +57,133 @@ void testInitAllocator(void) {
         }
     } CASE_COMPLETE;
 
+
+    TEST_CASE("head aligned to a cache line") {
+        Allocator allocator;
+        uint8_t memory[4096];
+        for (uint16_t block_size = 64; block_size  > 0; block_size--) {
+            indexSize_t overhead = initAllocatorAligned(&allocator, block_size, memory, 4096, 64);
+            ASSERT_TRUE(((uintptr_t)(allocator.memory.head)) % 64 == 0, "head not aligned for block size %d", block_size);
+            ASSERT_EQUAL_PTR((uint8_t*)(allocator.bitmaps.used), memory, "used bitmap placement is wrong");
+            ASSERT_TRUE((uint8_t*)allocator.memory.head >= (uint8_t*)allocator.bitmaps.used + BITMAP_COUNT * ((allocator.bitmaps.size + MAPSIZE - 1) / MAPSIZE) * sizeof(mapSize_t), "blocks overlap the bitmaps for block size %d", block_size);
+            ASSERT_TRUE((uint8_t*)allocator.memory.head + allocator.memory.size <= memory + 4096, "blocks exceed the memory region for block size %d", block_size);
+            ASSERT_EQUAL_INT(overhead + allocator.memory.size, 4096, "overhead not reported for block size %d", block_size);
+        }
+    } CASE_COMPLETE;
+
+    TEST_CASE("head aligned to a page") {
+        Allocator allocator;
+        static uint8_t memory[3 * 4096];
+        indexSize_t overhead = initAllocatorAligned(&allocator, 256, memory, 3 * 4096, 4096);
+        ASSERT_TRUE(((uintptr_t)(allocator.memory.head)) % 4096 == 0, "head not page aligned");
+        ASSERT_TRUE(allocator.bitmaps.size >= 16, "too few blocks after alignment");
+        ASSERT_EQUAL_INT(overhead + allocator.memory.size, 3 * 4096, "overhead not reported");
+
+        void* block = allocate(&allocator, 4096);
+        ASSERT_EQUAL_PTR(block, allocator.memory.head, "incorrect block head returned");
+        ASSERT_TRUE(deallocate(&allocator, block), "deallocation failed");
+    } CASE_COMPLETE;
+
+    TEST_CASE("external metadata") {
+        Allocator allocator;
+        uint8_t metadata[256];
+        uint8_t memory[128];
+        for (int index = 0; index < 256; index++) metadata[index] = 0;
+        for (int index = 0; index < 128; index++) memory[index] = 0;
+        indexSize_t size = allocatorMetadataSize(16, 128);
+        ASSERT_EQUAL_INT(size, metadata_size(1), "incorrect metadata size");
+        initAllocatorExternal(&allocator, 16, metadata, size, memory, 128);
+
+        ASSERT_EQUAL_INT(allocator.memory.size, 128, "incorrect size after initialization");
+        ASSERT_EQUAL_INT(allocator.bitmaps.size, 8, "incorrect bitmap size after initialization");
+        ASSERT_EQUAL_PTR((uint8_t*)(allocator.bitmaps.used), metadata, "used bitmap placement is wrong");
+        ASSERT_EQUAL_PTR((uint8_t*)(allocator.bitmaps.heads), metadata + sizeof(mapSize_t), "heads bitmap placement is wrong");
+        ASSERT_EQUAL_PTR((uint8_t*)(allocator.memory.head), memory, "head placement is wrong");
+
+        void* block = allocate(&allocator, 128);
+        ASSERT_EQUAL_PTR(block, memory, "incorrect block head returned");
+        ASSERT_TRUE(deallocate(&allocator, block), "deallocation failed");
+        for (int index = 0; index < (int)(2 * sizeof(mapSize_t)); index++) {
+            ASSERT_EQUAL_INT(metadata[index], 0, "metadata[%d] not clear after deallocation", index);
+        }
+    } CASE_COMPLETE;
+
+    TEST_CASE("external metadata too small") {
+        Allocator allocator;
+        uint8_t metadata[1024];
+        uint8_t memory[4 * MAPSIZE];
+        for (int index = 0; index < 1024; index++) metadata[index] = 0;
+        for (int index = 0; index < 4 * MAPSIZE; index++) memory[index] = 0;
+        ASSERT_EQUAL_INT(allocatorMetadataSize(1, 4 * MAPSIZE), metadata_size(4), "incorrect metadata size");
+        initAllocatorExternal(&allocator, 1, metadata, 2 * metadata_size(1) + 1, memory, 4 * MAPSIZE);
+
+        ASSERT_EQUAL_INT(allocator.bitmaps.size, 2 * MAPSIZE, "pool not truncated to the metadata");
+        ASSERT_EQUAL_INT(allocator.memory.size, 2 * MAPSIZE, "incorrect size after initialization");
+    } CASE_COMPLETE;
+
+#ifdef INTERLEAVE_MAPS
+    TEST_CASE("interleaved bitmaps") {
+        Allocator allocator;
+        uint8_t memory[4 * MAPSIZE * POOL_SCALE];
+        for (int index = 0; index < 4 * MAPSIZE * POOL_SCALE; index++) memory[index] = 0;
+        initAllocator(&allocator, 1, memory, 4 * MAPSIZE * POOL_SCALE);
+        mapSize_t* words = (mapSize_t*)memory;
+
+        ASSERT_EQUAL_PTR(allocator.bitmaps.heads, allocator.bitmaps.used + 1, "heads bitmap placement is wrong");
+        // an allocation starting in the second word of each map
+        allocate(&allocator, MAPSIZE);
+        void* block = allocate(&allocator, 1);
+        ASSERT_EQUAL_PTR(block, (uint8_t*)allocator.memory.head + MAPSIZE, "incorrect block head returned");
+        ASSERT_EQUAL_INT(words[BITMAP_COUNT], 1, "used bit not in the second group");
+        ASSERT_EQUAL_INT(words[BITMAP_COUNT + 1], 1, "heads bit not in the second group");
+    } CASE_COMPLETE;
+#endif
+
+#ifdef RUN_LENGTHS
+    TEST_CASE("run length table placement") {
+        Allocator allocator;
+        uint8_t memory[1024];
+        for (int index = 0; index < 1024; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 1024);
+        indexSize_t map_words = (allocator.bitmaps.size + MAPSIZE - 1) / MAPSIZE;
+
+        ASSERT_TRUE((uint8_t*)allocator.bitmaps.lengths >= memory + map_words * BITMAP_COUNT * sizeof(mapSize_t), "lengths overlap the bitmaps");
+        ASSERT_TRUE((uint8_t*)(allocator.bitmaps.lengths + allocator.bitmaps.size) <= (uint8_t*)allocator.memory.head, "lengths overlap the blocks");
+        ASSERT_TRUE((uint8_t*)allocator.memory.head + allocator.memory.size <= memory + 1024, "blocks exceed the memory region");
+        ASSERT_TRUE(((uint8_t*)allocator.memory.head - memory) % (2 * sizeof(mapSize_t)) == 0, "head not aligned");
+    } CASE_COMPLETE;
+
+    TEST_CASE("run longer than the table entry") {
+        Allocator allocator;
+        uint8_t memory[2048];
+        for (int index = 0; index < 2048; index++) memory[index] = 0;
+        initAllocator(&allocator, 1, memory, 2048);
+
+        void* block = allocate(&allocator, RUN_LENGTH_MAX + 45);
+        ASSERT_TRUE(block != NULL, "allocation failed");
+        ASSERT_EQUAL_PTR(block, allocator.memory.head, "allocation did not start at the first block");
+        ASSERT_EQUAL_INT(allocator.bitmaps.lengths[0], RUN_LENGTH_MAX, "long run not escaped");
+        ASSERT_EQUAL_INT(allocationSize(&allocator, block), RUN_LENGTH_MAX + 45, "escaped run measured wrongly");
+        ASSERT_FALSE(deallocateSized(&allocator, block, RUN_LENGTH_MAX - 1), "short deallocation succeeded");
+        ASSERT_TRUE(deallocateSized(&allocator, block, RUN_LENGTH_MAX + 45), "deallocation failed");
+    } CASE_COMPLETE;
+
+    TEST_CASE("mismatched size on a run longer than the table entry") {
+        Allocator allocator;
+        uint8_t memory[2048];
+        for (int index = 0; index < 2048; index++) memory[index] = 0;
+        initAllocator(&allocator, 1, memory, 2048);
+
+        uint8_t* block = allocate(&allocator, RUN_LENGTH_MAX + 45);
+        void* next = allocate(&allocator, 10);
+        ASSERT_EQUAL_PTR(next, block + RUN_LENGTH_MAX + 45, "second allocation not adjacent");
+        // ends on the free block after the second allocation, which the bitmaps alone would accept
+        ASSERT_FALSE(deallocateSized(&allocator, block, RUN_LENGTH_MAX + 55), "long deallocation succeeded");
+        ASSERT_FALSE(deallocateSized(&allocator, block, RUN_LENGTH_MAX + 1), "short deallocation succeeded");
+        ASSERT_EQUAL_INT(allocationSize(&allocator, next), 10, "second allocation was changed");
+        ASSERT_TRUE(deallocateSized(&allocator, block, RUN_LENGTH_MAX + 45), "deallocation failed");
+    } CASE_COMPLETE;
+#endif
 }
 
 void testAllocate() {
@@ -73,11 +220,11 @@ void testAllocate() {
 
     TEST_CASE("allocating block that spans two bitmap blocks") {
         Allocator allocator;
-        uint8_t memory[4 * MAPSIZE];
+        uint8_t memory[4 * MAPSIZE * POOL_SCALE];
         uint16_t offset = 0;
 
-        for (int index = 0; index < (4 * MAPSIZE); index++) memory[index] = 0;
-        initAllocator(&allocator, 1, memory, 4 * MAPSIZE);
+        for (int index = 0; index < (4 * MAPSIZE * POOL_SCALE); index++) memory[index] = 0;
+        initAllocator(&allocator, 1, memory, 4 * MAPSIZE * POOL_SCALE);
 
         void* block1 = allocate(&allocator, (3 * MAPSIZE) / 2);
         void* block2 = allocate(&allocator, MAPSIZE);
@@ -107,6 +254,21 @@ void testAllocate() {
 
     } CASE_COMPLETE;
 
+    TEST_CASE("allocating every block of a large pool") {
+        Allocator allocator;
+        uint8_t memory[1024];
+        for (int index = 0; index < 1024; index++) memory[index] = 0;
+        initAllocator(&allocator, 2, memory, 1024);
+
+        // indices past the largest bitmap word value must still be usable
+        for (uint16_t i = 0; i < allocator.bitmaps.size; i++) {
+            void* block = allocate(&allocator, 2);
+            ASSERT_EQUAL_PTR(block, (uint8_t*)allocator.memory.head + 2 * i, "incorrect block[%d] returned", i);
+        }
+        ASSERT_EQUAL_PTR(allocate(&allocator, 2), NULL, "invalid allocation returned non-null");
+        ASSERT_EQUAL_PTR(allocate(&allocator, 0), NULL, "empty allocation returned non-null");
+    } CASE_COMPLETE;
+
     TEST_CASE("allocating odd sized block") {
         Allocator allocator;
         uint8_t memory[128];
@@ -185,10 +347,761 @@ void testDeallocate() {
     } CASE_COMPLETE;
 }
 
+void testDeallocateSized() {
+
+    TEST_CASE("deallocating block with its size") {
+        Allocator allocator;
+        uint8_t memory[4 * MAPSIZE * POOL_SCALE];
+        for (int index = 0; index < 4 * MAPSIZE * POOL_SCALE; index++) memory[index] = 0;
+        initAllocator(&allocator, 1, memory, 4 * MAPSIZE * POOL_SCALE);
+
+        void* block1 = allocate(&allocator, 3);
+        void* block2 = allocate(&allocator, (3 * MAPSIZE) / 2);
+        void* block3 = allocate(&allocator, 1);
+        ASSERT_TRUE(deallocateSized(&allocator, block2, (3 * MAPSIZE) / 2), "deallocating block2 failed");
+
+        ASSERT_FALSE(get_bit(allocator.bitmaps.heads, 3), "heads bit still set after deallocation");
+        for (uint16_t i = 3; i < 3 + (3 * MAPSIZE) / 2; i++) {
+            ASSERT_FALSE(get_bit(allocator.bitmaps.used, i), "used bit[%d] still set after deallocation", i);
+        }
+        ASSERT_TRUE(get_bit(allocator.bitmaps.used, 2), "previous used bit cleared after deallocation");
+        ASSERT_TRUE(get_bit(allocator.bitmaps.heads, 3 + (3 * MAPSIZE) / 2), "next heads bit cleared after deallocation");
+        ASSERT_TRUE(deallocateSized(&allocator, block1, 3), "deallocating block1 failed");
+        ASSERT_TRUE(deallocateSized(&allocator, block3, 1), "deallocating block3 failed");
+        for (uint16_t i = 0; i < allocator.bitmaps.size; i++) {
+            ASSERT_FALSE(get_bit(allocator.bitmaps.used, i), "used bit[%d] still set", i);
+        }
+    } CASE_COMPLETE;
+
+    TEST_CASE("deallocating with a rounded size") {
+        Allocator allocator;
+        uint8_t memory[128];
+        for (int index = 0; index < 128; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 128);
+
+        void* block = allocate(&allocator, allocator.memory.size - 5);
+        ASSERT_TRUE(deallocateSized(&allocator, block, allocator.memory.size - 5), "deallocating whole pool failed");
+        ASSERT_EQUAL_PTR(allocate(&allocator, allocator.memory.size), block, "pool not free after deallocation");
+    } CASE_COMPLETE;
+
+    TEST_CASE("deallocating with a mismatched size") {
+        Allocator allocator;
+        uint8_t memory[256];
+        for (int index = 0; index < 256; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 256);
+
+        uint8_t* block = allocate(&allocator, 48);
+        ASSERT_FALSE(deallocateSized(&allocator, block, 16), "undersized deallocation succeeded");
+        ASSERT_FALSE(deallocateSized(&allocator, block, 0), "empty deallocation succeeded");
+        ASSERT_FALSE(deallocateSized(&allocator, block, 1024), "deallocation past the pool succeeded");
+        ASSERT_FALSE(deallocateSized(&allocator, block + 16, 32), "deallocation of a non-head block succeeded");
+        ASSERT_TRUE(get_bit(allocator.bitmaps.heads, 0), "heads bit cleared by a rejected deallocation");
+        for (uint16_t i = 0; i < 3; i++) {
+            ASSERT_TRUE(get_bit(allocator.bitmaps.used, i), "used bit[%d] cleared by a rejected deallocation", i);
+        }
+#ifdef RUN_LENGTHS
+        void* next = allocate(&allocator, 16);
+        ASSERT_FALSE(deallocateSized(&allocator, block, 64), "oversized deallocation succeeded");
+        ASSERT_TRUE(get_bit(allocator.bitmaps.heads, 3), "oversized deallocation freed the next allocation");
+        ASSERT_TRUE(deallocate(&allocator, next), "deallocation failed");
+#endif
+        ASSERT_TRUE(deallocateSized(&allocator, block, 48), "deallocation failed");
+        ASSERT_FALSE(deallocateSized(&allocator, block, 48), "double deallocation succeeded");
+    } CASE_COMPLETE;
+}
+
+void testAllocateZeroed() {
+
+    TEST_CASE("zeroing reused block") {
+        Allocator allocator;
+        uint8_t memory[128];
+        for (int index = 0; index < 128; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 128);
+
+        uint8_t* block = allocate(&allocator, 32);
+        for (int i = 0; i < 32; i++) block[i] = 0xA5;
+        ASSERT_TRUE(deallocate(&allocator, block), "deallocation failed");
+
+        uint8_t* zeroed = allocateZeroed(&allocator, 20);
+        ASSERT_EQUAL_PTR(zeroed, block, "freed block was not reused");
+        for (int i = 0; i < 32; i++) {
+            ASSERT_EQUAL_INT(zeroed[i], 0, "byte[%d] was not zeroed", i);
+        }
+        ASSERT_TRUE(get_bit(allocator.bitmaps.heads, 0), "heads bit not set");
+        ASSERT_TRUE(get_bit(allocator.bitmaps.used, 1), "used bit not set");
+    } CASE_COMPLETE;
+
+    TEST_CASE("zeroing impossibly large block") {
+        Allocator allocator;
+        uint8_t memory[128];
+        for (int index = 0; index < 128; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 128);
+
+        ASSERT_EQUAL_PTR(allocateZeroed(&allocator, 1024), NULL, "invalid allocation returned non-null");
+    } CASE_COMPLETE;
+
+#ifdef DIRTY_MAP
+    TEST_CASE("clean blocks are not cleared") {
+        Allocator allocator;
+        uint8_t memory[128];
+        for (int index = 0; index < 128; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 128);
+
+        // a block that was never handed out is trusted to still be zero
+        uint8_t* head = allocator.memory.head;
+        head[0] = 0xA5;
+        uint8_t* block = allocateZeroed(&allocator, 16);
+        ASSERT_EQUAL_PTR(block, head, "incorrect block head returned");
+        ASSERT_EQUAL_INT(block[0], 0xA5, "clean block was cleared");
+        ASSERT_TRUE(get_bit(allocator.bitmaps.dirty, 0), "dirty bit not set");
+        ASSERT_FALSE(get_bit(allocator.bitmaps.dirty, 1), "dirty bit[1] was set");
+    } CASE_COMPLETE;
+
+    TEST_CASE("scrubbing free blocks") {
+        Allocator allocator;
+        uint8_t memory[128];
+        for (int index = 0; index < 128; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 128);
+
+        uint8_t* block1 = allocate(&allocator, 32);
+        uint8_t* block2 = allocate(&allocator, 16);
+        for (int i = 0; i < 32; i++) block1[i] = 0xA5;
+        block2[0] = 0x5A;
+        ASSERT_TRUE(deallocate(&allocator, block1), "deallocation failed");
+
+        ASSERT_EQUAL_INT(scrubFreeBlocks(&allocator, 1), 1, "incorrect number of blocks scrubbed");
+        ASSERT_EQUAL_INT(scrubFreeBlocks(&allocator, 8), 1, "incorrect number of blocks scrubbed");
+        ASSERT_EQUAL_INT(scrubFreeBlocks(&allocator, 8), 0, "clean blocks were scrubbed");
+        for (int i = 0; i < 32; i++) {
+            ASSERT_EQUAL_INT(block1[i], 0, "byte[%d] was not scrubbed", i);
+        }
+        ASSERT_EQUAL_INT(block2[0], 0x5A, "allocated block was scrubbed");
+        ASSERT_FALSE(get_bit(allocator.bitmaps.dirty, 0), "dirty bit[0] still set");
+        ASSERT_FALSE(get_bit(allocator.bitmaps.dirty, 1), "dirty bit[1] still set");
+        ASSERT_TRUE(get_bit(allocator.bitmaps.dirty, 2), "dirty bit[2] was cleared");
+    } CASE_COMPLETE;
+#endif
+}
+
+void testAllocateAligned() {
+
+    TEST_CASE("aligning to a multiple of the block size") {
+        Allocator allocator;
+        uint8_t memory[4096];
+        for (int index = 0; index < 4096; index++) memory[index] = 0;
+        initAllocatorAligned(&allocator, 16, memory, 4096, 16);
+
+        void* block1 = allocate(&allocator, 16);
+        uint8_t* block2 = allocateAligned(&allocator, 40, 64);
+        ASSERT_NOT_EQUAL_PTR(block1, NULL, "valid allocation returned null");
+        ASSERT_NOT_EQUAL_PTR(block2, NULL, "valid allocation returned null");
+        ASSERT_TRUE((uintptr_t)block2 % 64 == 0, "block not aligned");
+        ASSERT_TRUE(block2 - (uint8_t*)allocator.memory.head < 64 + 16, "aligned block was not the first candidate");
+
+        indexSize_t index = (block2 - (uint8_t*)allocator.memory.head) / 16;
+        ASSERT_TRUE(get_bit(allocator.bitmaps.heads, index), "heads bit not set");
+        for (indexSize_t i = 0; i < 3; i++) {
+            ASSERT_TRUE(get_bit(allocator.bitmaps.used, index + i), "used bit[%d] not set", i);
+        }
+        ASSERT_FALSE(get_bit(allocator.bitmaps.used, index + 3), "used bit after block was set");
+        ASSERT_TRUE(deallocate(&allocator, block2), "deallocation failed");
+    } CASE_COMPLETE;
+
+    TEST_CASE("aligning with an odd block size") {
+        Allocator allocator;
+        uint8_t memory[4096 + 8];
+        for (int index = 0; index < 4096 + 8; index++) memory[index] = 0;
+        // 24 byte blocks can only reach 32 byte alignment from an 8 byte aligned head
+        initAllocator(&allocator, 24, memory, 4096);
+        uint16_t offset = (8 - ((uintptr_t)allocator.memory.head % 8)) % 8;
+        initAllocator(&allocator, 24, memory + offset, 4096);
+
+        void* block1 = allocateAligned(&allocator, 24, 32);
+        void* block2 = allocateAligned(&allocator, 24, 32);
+        ASSERT_NOT_EQUAL_PTR(block1, NULL, "valid allocation returned null");
+        ASSERT_NOT_EQUAL_PTR(block2, NULL, "valid allocation returned null");
+        ASSERT_TRUE((uintptr_t)block1 % 32 == 0, "block1 not aligned");
+        ASSERT_TRUE((uintptr_t)block2 % 32 == 0, "block2 not aligned");
+        ASSERT_EQUAL_PTR((uint8_t*)block1 + 4 * 24, (uint8_t*)block2, "aligned blocks not 4 blocks apart");
+    } CASE_COMPLETE;
+
+    TEST_CASE("first aligned block of a byte-sized pool") {
+        Allocator allocator;
+        uint8_t memory[1024];
+        for (int index = 0; index < 1024; index++) memory[index] = 0;
+        initAllocator(&allocator, 1, memory, 1024);
+
+        uintptr_t head = (uintptr_t)allocator.memory.head;
+        uint8_t* expected = (uint8_t*)allocator.memory.head + (256 - head % 256) % 256;
+        uint8_t* block = allocateAligned(&allocator, 8, 256);
+        ASSERT_EQUAL_PTR(block, expected, "block did not start at the first 256 byte boundary");
+    } CASE_COMPLETE;
+
+    TEST_CASE("alignment out of reach of the head") {
+        Allocator allocator;
+        uint8_t memory[4096 + 8];
+        for (int index = 0; index < 4096 + 8; index++) memory[index] = 0;
+        // 24 byte blocks never reach 32 byte alignment from a head 4 bytes off an 8 byte boundary
+        initAllocator(&allocator, 24, memory, 4096);
+        uint16_t offset = (12 - ((uintptr_t)allocator.memory.head % 8)) % 8;
+        initAllocator(&allocator, 24, memory + offset, 4096);
+
+        ASSERT_EQUAL_PTR(allocateAligned(&allocator, 24, 32), NULL, "unreachable alignment returned non-null");
+        ASSERT_NOT_EQUAL_PTR(allocateAligned(&allocator, 24, 4), NULL, "reachable alignment returned null");
+    } CASE_COMPLETE;
+
+    TEST_CASE("skipping candidates blocked by used blocks") {
+        Allocator allocator;
+        uint8_t memory[4096];
+        for (int index = 0; index < 4096; index++) memory[index] = 0;
+        initAllocatorAligned(&allocator, 16, memory, 4096, 16);
+
+        // occupy everything up to and including the second aligned candidate
+        uint8_t* aligned = allocateAligned(&allocator, 16, 64);
+        indexSize_t first = (aligned - (uint8_t*)allocator.memory.head) / 16;
+        ASSERT_TRUE(deallocate(&allocator, aligned), "deallocation failed");
+        void* filler = allocate(&allocator, (first + 5) * 16);
+        ASSERT_NOT_EQUAL_PTR(filler, NULL, "valid allocation returned null");
+
+        uint8_t* block = allocateAligned(&allocator, 64, 64);
+        ASSERT_EQUAL_PTR(block, aligned + 128, "block did not start at the third candidate");
+    } CASE_COMPLETE;
+
+    TEST_CASE("invalid alignments") {
+        Allocator allocator;
+        uint8_t memory[128];
+        for (int index = 0; index < 128; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 128);
+
+        ASSERT_EQUAL_PTR(allocateAligned(&allocator, 16, 0), NULL, "zero alignment returned non-null");
+        ASSERT_EQUAL_PTR(allocateAligned(&allocator, 16, 48), NULL, "non power of two alignment returned non-null");
+        // The pool lies wherever the stack put it, so it may hold a block on a 4096-byte boundary
+        uint8_t* expected = NULL;
+        for (indexSize_t index = 0; index < allocator.bitmaps.size && expected == NULL; index++) {
+            uint8_t* candidate = (uint8_t*)allocator.memory.head + index * 16;
+            if ((uintptr_t)candidate % 4096 == 0) expected = candidate;
+        }
+        void* block = allocateAligned(&allocator, 16, 4096);
+        ASSERT_EQUAL_PTR(block, expected, "alignment beyond the pool not handled");
+        if (block != NULL) {
+            ASSERT_TRUE(deallocate(&allocator, block), "deallocation failed");
+        }
+        for (uint16_t i = 0; i < allocator.bitmaps.size; i++) {
+            ASSERT_FALSE(get_bit(allocator.bitmaps.used, i), "used bit[%d] was set", i);
+        }
+    } CASE_COMPLETE;
+}
+
+void testAllocationSize() {
+
+    TEST_CASE("sizes of adjacent allocations") {
+        Allocator allocator;
+        uint8_t memory[4 * MAPSIZE * POOL_SCALE];
+        for (int index = 0; index < 4 * MAPSIZE * POOL_SCALE; index++) memory[index] = 0;
+        initAllocator(&allocator, 1, memory, 4 * MAPSIZE * POOL_SCALE);
+
+        void* block1 = allocate(&allocator, 3);
+        void* block2 = allocate(&allocator, (3 * MAPSIZE) / 2);
+        void* block3 = allocate(&allocator, 1);
+        ASSERT_EQUAL_INT(allocationSize(&allocator, block1), 3, "incorrect size for block1");
+        ASSERT_EQUAL_INT(allocationSize(&allocator, block2), (3 * MAPSIZE) / 2, "incorrect size for block spanning bitmap words");
+        ASSERT_EQUAL_INT(allocationSize(&allocator, block3), 1, "incorrect size for block3");
+    } CASE_COMPLETE;
+
+    TEST_CASE("size is rounded to the block size") {
+        Allocator allocator;
+        uint8_t memory[128];
+        for (int index = 0; index < 128; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 128);
+
+        void* block = allocate(&allocator, 17);
+        ASSERT_EQUAL_INT(allocationSize(&allocator, block), 32, "size not rounded to the block size");
+    } CASE_COMPLETE;
+
+    TEST_CASE("size of allocation ending the pool") {
+        Allocator allocator;
+        uint8_t memory[128];
+        for (int index = 0; index < 128; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 128);
+
+        void* block = allocate(&allocator, allocator.memory.size);
+        ASSERT_EQUAL_INT(allocationSize(&allocator, block), allocator.memory.size, "incorrect size for whole pool");
+    } CASE_COMPLETE;
+
+    TEST_CASE("size of invalid pointers") {
+        Allocator allocator;
+        uint8_t memory[128];
+        for (int index = 0; index < 128; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 128);
+
+        uint8_t* block = allocate(&allocator, 32);
+        ASSERT_EQUAL_INT(allocationSize(&allocator, block + 2), 0, "pointer inside a block has a size");
+        ASSERT_EQUAL_INT(allocationSize(&allocator, block + 16), 0, "pointer to a non-head block has a size");
+        ASSERT_EQUAL_INT(allocationSize(&allocator, block + 32), 0, "pointer to a free block has a size");
+        ASSERT_EQUAL_INT(allocationSize(&allocator, memory), 0, "pointer before the pool has a size");
+        ASSERT_EQUAL_INT(allocationSize(&allocator, memory + 128), 0, "pointer after the pool has a size");
+        ASSERT_TRUE(deallocate(&allocator, block), "deallocation failed");
+        ASSERT_EQUAL_INT(allocationSize(&allocator, block), 0, "deallocated block has a size");
+    } CASE_COMPLETE;
+}
+
+void testGetAllocatorStats(void) {
+
+    TEST_CASE("stats after initialization") {
+        Allocator allocator;
+        uint8_t memory[256];
+        for (int index = 0; index < 256; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 256);
+        AllocatorStats stats = getAllocatorStats(&allocator);
+
+        ASSERT_EQUAL_INT(stats.free_blocks, allocator.bitmaps.size, "free blocks do not cover the pool");
+        ASSERT_EQUAL_INT(stats.allocated_blocks, 0, "blocks allocated after initialization");
+        ASSERT_EQUAL_INT(stats.live_allocations, 0, "allocations live after initialization");
+        ASSERT_EQUAL_INT(stats.high_water_blocks, 0, "high-water mark set after initialization");
+    } CASE_COMPLETE;
+
+    TEST_CASE("stats track allocations and deallocations") {
+        Allocator allocator;
+        uint8_t memory[256];
+        for (int index = 0; index < 256; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 256);
+        indexSize_t pool = allocator.bitmaps.size;
+
+        void* first = allocate(&allocator, 40);
+        void* second = allocateZeroed(&allocator, 16);
+        void* third = allocate(&allocator, 1);
+        AllocatorStats stats = getAllocatorStats(&allocator);
+        ASSERT_EQUAL_INT(stats.allocated_blocks, 5, "allocated blocks not counted");
+        ASSERT_EQUAL_INT(stats.free_blocks, pool - 5, "free blocks not counted");
+        ASSERT_EQUAL_INT(stats.live_allocations, 3, "live allocations not counted");
+        ASSERT_EQUAL_INT(stats.high_water_blocks, 5, "high-water mark not raised");
+
+        ASSERT_TRUE(deallocate(&allocator, first), "deallocation failed");
+        ASSERT_TRUE(deallocateSized(&allocator, second, 16), "deallocation failed");
+        stats = getAllocatorStats(&allocator);
+        ASSERT_EQUAL_INT(stats.allocated_blocks, 1, "deallocated blocks still counted");
+        ASSERT_EQUAL_INT(stats.free_blocks, pool - 1, "deallocated blocks not freed");
+        ASSERT_EQUAL_INT(stats.live_allocations, 1, "deallocations not counted");
+        ASSERT_EQUAL_INT(stats.high_water_blocks, 5, "high-water mark lowered");
+
+        ASSERT_FALSE(deallocate(&allocator, first), "double deallocation succeeded");
+        ASSERT_EQUAL_INT(getAllocatorStats(&allocator).live_allocations, 1, "rejected deallocation counted");
+        ASSERT_TRUE(allocate(&allocator, pool * 16) == NULL, "oversized allocation succeeded");
+        ASSERT_EQUAL_INT(getAllocatorStats(&allocator).allocated_blocks, 1, "failed allocation counted");
+        ASSERT_TRUE(deallocate(&allocator, third), "deallocation failed");
+    } CASE_COMPLETE;
+}
+
+void testGetFragmentationStats(void) {
+
+    TEST_CASE("empty pool is one free run") {
+        Allocator allocator;
+        uint8_t memory[1024];
+        for (int index = 0; index < 1024; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 1024);
+        indexSize_t pool = allocator.bitmaps.size;
+        FragmentationStats stats = getFragmentationStats(&allocator);
+
+        ASSERT_EQUAL_INT(stats.free_blocks, pool, "free blocks do not cover the pool");
+        ASSERT_EQUAL_INT(stats.free_runs, 1, "empty pool split into several runs");
+        ASSERT_EQUAL_INT(stats.largest_free_run, pool, "largest run is not the whole pool");
+        ASSERT_TRUE(stats.external_fragmentation == 0.0f, "empty pool reported as fragmented");
+    } CASE_COMPLETE;
+
+    TEST_CASE("full pool has no free runs") {
+        Allocator allocator;
+        uint8_t memory[1024];
+        for (int index = 0; index < 1024; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 1024);
+        ASSERT_TRUE(allocate(&allocator, allocator.memory.size) != NULL, "allocation failed");
+        FragmentationStats stats = getFragmentationStats(&allocator);
+
+        ASSERT_EQUAL_INT(stats.free_blocks, 0, "full pool has free blocks");
+        ASSERT_EQUAL_INT(stats.free_runs, 0, "full pool has free runs");
+        ASSERT_EQUAL_INT(stats.largest_free_run, 0, "full pool has a free run");
+        ASSERT_TRUE(stats.external_fragmentation == 0.0f, "full pool reported as fragmented");
+    } CASE_COMPLETE;
+
+    TEST_CASE("runs across word boundaries") {
+        Allocator allocator;
+        uint8_t memory[1024];
+        for (int index = 0; index < 1024; index++) memory[index] = 0;
+        initAllocator(&allocator, 1, memory, 1024);
+        indexSize_t pool = allocator.bitmaps.size;
+
+        // Holes of 1, 3 and MAPSIZE + 2 blocks between allocations, then the free tail
+        uint8_t* first = allocate(&allocator, 2);
+        uint8_t* hole1 = allocate(&allocator, 1);
+        uint8_t* second = allocate(&allocator, 1);
+        uint8_t* hole2 = allocate(&allocator, 3);
+        uint8_t* third = allocate(&allocator, MAPSIZE - 1);
+        uint8_t* hole3 = allocate(&allocator, MAPSIZE + 2);
+        uint8_t* fourth = allocate(&allocator, 5);
+        ASSERT_TRUE(first && second && third && fourth, "allocation failed");
+        ASSERT_TRUE(deallocate(&allocator, hole1), "deallocation failed");
+        ASSERT_TRUE(deallocate(&allocator, hole2), "deallocation failed");
+        ASSERT_TRUE(deallocate(&allocator, hole3), "deallocation failed");
+        indexSize_t tail = pool - (2 + 1 + 1 + 3 + (MAPSIZE - 1) + (MAPSIZE + 2) + 5);
+        FragmentationStats stats = getFragmentationStats(&allocator);
+
+        ASSERT_EQUAL_INT(stats.free_blocks, getAllocatorStats(&allocator).free_blocks, "free blocks disagree with the counters");
+        ASSERT_EQUAL_INT(stats.free_runs, 4, "wrong number of free runs");
+        ASSERT_EQUAL_INT(stats.largest_free_run, tail, "wrong largest free run");
+        ASSERT_EQUAL_INT(stats.histogram[0], 1, "single-block hole not counted");
+        ASSERT_EQUAL_INT(stats.histogram[1], 1, "three-block hole not counted");
+        indexSize_t total = 0;
+        for (int i = 0; i < FREE_RUN_BUCKETS; i++) total += stats.histogram[i];
+        ASSERT_EQUAL_INT(total, 4, "histogram does not cover every run");
+        float expected = 1.0f - (float)tail / (float)stats.free_blocks;
+        ASSERT_TRUE(stats.external_fragmentation == expected, "wrong external fragmentation");
+    } CASE_COMPLETE;
+}
+
+void testDumpAllocator(void) {
+
+    TEST_CASE("snapshot of parameters and bitmaps") {
+        Allocator allocator;
+        uint8_t memory[1024];
+        for (int index = 0; index < 1024; index++) memory[index] = 0;
+        initAllocator(&allocator, 1, memory, 1024);
+        indexSize_t pool = allocator.bitmaps.size;
+
+        // A freed hole of 3 blocks, then an allocation crossing a word boundary
+        uint8_t* hole = allocate(&allocator, 3);
+        uint8_t* kept = allocate(&allocator, MAPSIZE + 1);
+        ASSERT_TRUE(hole && kept, "allocation failed");
+        ASSERT_TRUE(deallocate(&allocator, hole), "deallocation failed");
+        size_t map_bytes = (pool + 7) / 8;
+        size_t size = dumpAllocator(&allocator, NULL, 0);
+        ASSERT_EQUAL_INT((int)size, (int)(sizeof(AllocatorDumpHeader) + 2 * map_bytes), "wrong snapshot size");
+
+        uint8_t dump[sizeof(AllocatorDumpHeader) + 2 * 128];
+        ASSERT_TRUE(size <= sizeof(dump), "snapshot larger than expected");
+        ASSERT_EQUAL_INT((int)dumpAllocator(&allocator, dump, sizeof(dump)), (int)size, "wrong size written");
+        AllocatorDumpHeader header;
+        memcpy(&header, dump, sizeof(header));
+        ASSERT_TRUE(header.magic == ALLOCATOR_DUMP_MAGIC, "wrong magic");
+        ASSERT_EQUAL_INT(header.version, ALLOCATOR_DUMP_VERSION, "wrong version");
+        ASSERT_EQUAL_INT(header.mapsize, MAPSIZE, "wrong map size");
+        ASSERT_EQUAL_INT((int)header.block_size, 1, "wrong block size");
+        ASSERT_EQUAL_INT((int)header.blocks, (int)pool, "wrong block count");
+        ASSERT_EQUAL_INT((int)header.allocated_blocks, MAPSIZE + 1, "wrong allocated blocks");
+        ASSERT_EQUAL_INT((int)header.live_allocations, 1, "wrong live allocations");
+        ASSERT_EQUAL_INT((int)header.high_water_blocks, MAPSIZE + 4, "wrong high water mark");
+
+        const uint8_t* used = dump + sizeof(header);
+        const uint8_t* heads = used + map_bytes;
+        for (indexSize_t index = 0; index < pool; index++) {
+            bool in_use = index >= 3 && index < MAPSIZE + 4;
+            bool used_bit = (used[index / 8] >> (index % 8)) & 1;
+            bool head_bit = (heads[index / 8] >> (index % 8)) & 1;
+            ASSERT_TRUE(used_bit == in_use, "wrong used bit");
+            ASSERT_TRUE(head_bit == (index == 3), "wrong head bit");
+        }
+    } CASE_COMPLETE;
+}
+
+void testExportAllocatorStats(void) {
+
+    TEST_CASE("prometheus and json text") {
+        Allocator allocator;
+        uint8_t memory[1024];
+        for (int index = 0; index < 1024; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 1024);
+        ASSERT_TRUE(allocate(&allocator, 40) != NULL, "allocation failed");
+
+        char text[8192];
+        size_t length = exportAllocatorStats(&allocator, STATS_PROMETHEUS, text, sizeof(text));
+        ASSERT_TRUE(length < sizeof(text), "buffer too small for the export");
+        ASSERT_EQUAL_INT((int)strlen(text), (int)length, "wrong length returned");
+        ASSERT_TRUE(strstr(text, "# TYPE allocator_live_allocations gauge\nallocator_live_allocations 1\n") != NULL, "live allocations missing");
+        ASSERT_TRUE(strstr(text, "allocator_allocated_blocks 3\n") != NULL, "allocated blocks missing");
+        ASSERT_TRUE(strstr(text, "allocator_free_runs 1\n") != NULL, "free runs missing");
+        ASSERT_TRUE(strstr(text, "allocator_external_fragmentation 0.0000\n") != NULL, "fragmentation missing");
+        ASSERT_TRUE(strstr(text, "allocator_free_runs_by_length{min_blocks=\"1\"} 0\n") != NULL, "run histogram missing");
+#ifdef LATENCY_HISTOGRAMS
+        // A summary needs both its sum and its count for averages
+        ASSERT_TRUE(strstr(text, "# TYPE allocator_allocate_latency_ticks summary\n") != NULL, "latency summary missing");
+        ASSERT_TRUE(strstr(text, "\nallocator_allocate_latency_ticks_sum ") != NULL, "latency sum missing");
+        ASSERT_TRUE(strstr(text, "\nallocator_allocate_latency_ticks_count ") != NULL, "latency count missing");
+#endif
+
+        length = exportAllocatorStats(&allocator, STATS_JSON, text, sizeof(text));
+        ASSERT_TRUE(length < sizeof(text), "buffer too small for the export");
+        ASSERT_TRUE(text[0] == '{' && text[length - 1] == '}', "not a JSON object");
+        ASSERT_TRUE(strstr(text, "{\"block_size_bytes\":16,") != NULL, "block size missing");
+        ASSERT_TRUE(strstr(text, ",\"live_allocations\":1,") != NULL, "live allocations missing");
+        ASSERT_TRUE(strstr(text, ",\"free_runs_by_length\":{\"1\":0,") != NULL, "run histogram missing");
+    } CASE_COMPLETE;
+
+    TEST_CASE("text cut short by a small buffer") {
+        Allocator allocator;
+        uint8_t memory[1024];
+        for (int index = 0; index < 1024; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 1024);
+        size_t full = exportAllocatorStats(&allocator, STATS_JSON, NULL, 0);
+        char text[16];
+        for (int index = 0; index < 16; index++) text[index] = 'x';
+        ASSERT_EQUAL_INT((int)exportAllocatorStats(&allocator, STATS_JSON, text, 10), (int)full, "length depends on the buffer");
+        ASSERT_EQUAL_INT((int)strlen(text), 9, "text not terminated at the end of the buffer");
+        ASSERT_TRUE(text[10] == 'x', "wrote past the buffer");
+    } CASE_COMPLETE;
+}
+
+#ifdef ALLOCATION_TRACE
+void testAllocationTrace(void) {
+
+    TEST_CASE("calls are recorded in order") {
+        Allocator allocator;
+        uint8_t memory[256];
+        for (int index = 0; index < 256; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 256);
+        TraceRecord records[8];
+        setTraceBuffer(&allocator, records, 8);
+
+        void* block = allocate(&allocator, 20);
+        ASSERT_TRUE(block != NULL, "allocation failed");
+        ASSERT_TRUE(allocate(&allocator, 4096) == NULL, "oversized allocation succeeded");
+        ASSERT_TRUE(deallocate(&allocator, block), "deallocation failed");
+
+        ASSERT_EQUAL_INT((int)allocator.trace.written, 3, "wrong number of records");
+        ASSERT_EQUAL_INT(TRACE_RECORD_OP(&records[0]), TRACE_ALLOCATE, "allocation not recorded");
+        ASSERT_EQUAL_INT((int)records[0].size, 20, "requested size not recorded");
+        ASSERT_EQUAL_INT(TRACE_RECORD_OP(&records[1]), TRACE_FAILED, "failed allocation not recorded");
+        ASSERT_EQUAL_INT((int)records[1].size, 4096, "failed size not recorded");
+        ASSERT_EQUAL_INT(TRACE_RECORD_OP(&records[2]), TRACE_DEALLOCATE, "deallocation not recorded");
+        ASSERT_EQUAL_INT((int)records[2].index, (int)records[0].index, "deallocated index differs");
+        ASSERT_EQUAL_INT((int)records[2].size, 32, "freed size not recorded");
+        ASSERT_TRUE(TRACE_RECORD_TIME(&records[2]) >= TRACE_RECORD_TIME(&records[0]), "timestamps out of order");
+    } CASE_COMPLETE;
+
+    TEST_CASE("ring buffer wraps") {
+        Allocator allocator;
+        uint8_t memory[256];
+        for (int index = 0; index < 256; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 256);
+        TraceRecord records[2];
+        setTraceBuffer(&allocator, records, 2);
+
+        for (int i = 0; i < 3; i++) ASSERT_TRUE(allocate(&allocator, 16) != NULL, "allocation failed");
+        ASSERT_EQUAL_INT((int)allocator.trace.written, 3, "wrong number of records");
+        ASSERT_EQUAL_INT((int)records[0].index, 2, "oldest record not overwritten");
+        ASSERT_EQUAL_INT((int)records[1].index, 1, "newer record overwritten");
+
+        setTraceBuffer(&allocator, NULL, 0);
+        ASSERT_TRUE(allocate(&allocator, 16) != NULL, "allocation failed");
+        ASSERT_EQUAL_INT((int)allocator.trace.written, 0, "recorded while off");
+    } CASE_COMPLETE;
+}
+#endif
+
+#ifdef HEAP_PROFILE
+void testHeapProfile(void) {
+
+    TEST_CASE("live samples grouped by call site") {
+        Allocator allocator;
+        uint8_t memory[1024];
+        for (int index = 0; index < 1024; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 1024);
+        // Sample every allocation
+        setHeapProfileInterval(&allocator, 1);
+
+        void* blocks[3];
+        for (int i = 0; i < 3; i++) blocks[i] = allocate(&allocator, 32);
+        void* other = allocate(&allocator, 16);
+        ASSERT_TRUE(blocks[0] && blocks[1] && blocks[2] && other, "allocation failed");
+        ASSERT_TRUE(deallocate(&allocator, blocks[1]), "deallocation failed");
+        CallsiteProfile callsites[4];
+        indexSize_t count = dumpHeapProfile(&allocator, callsites, 4);
+
+        ASSERT_EQUAL_INT(count, 2, "wrong number of call sites");
+        ASSERT_EQUAL_INT(callsites[0].samples, 2, "deallocated sample still live");
+        ASSERT_EQUAL_INT((int)callsites[0].sampled_bytes, 64, "wrong sampled bytes");
+        ASSERT_EQUAL_INT(callsites[1].samples, 1, "second call site not sampled");
+        ASSERT_TRUE(callsites[0].callsite != callsites[1].callsite, "call sites not told apart");
+        ASSERT_FALSE(get_bit(allocator.bitmaps.sampled, 2), "sampled bit kept after deallocation");
+        ASSERT_EQUAL_INT(dumpHeapProfile(&allocator, callsites, 1), 1, "capacity exceeded");
+    } CASE_COMPLETE;
+
+    TEST_CASE("sampling off and full slots") {
+        Allocator allocator;
+        uint8_t memory[2048];
+        for (int index = 0; index < 2048; index++) memory[index] = 0;
+        initAllocator(&allocator, 1, memory, 2048);
+        CallsiteProfile callsite;
+
+        setHeapProfileInterval(&allocator, 0);
+        ASSERT_TRUE(allocate(&allocator, 8) != NULL, "allocation failed");
+        ASSERT_EQUAL_INT(dumpHeapProfile(&allocator, &callsite, 1), 0, "allocation sampled while off");
+
+        setHeapProfileInterval(&allocator, 1);
+        for (int i = 0; i < HEAP_PROFILE_SLOTS + 3; i++) ASSERT_TRUE(allocate(&allocator, 1) != NULL, "allocation failed");
+        ASSERT_EQUAL_INT((int)allocator.profile.dropped, 3, "overflowing samples not dropped");
+        ASSERT_EQUAL_INT(dumpHeapProfile(&allocator, &callsite, 1), 1, "slots not merged into one call site");
+        ASSERT_EQUAL_INT(callsite.samples, HEAP_PROFILE_SLOTS, "wrong number of live samples");
+    } CASE_COMPLETE;
+}
+#endif
+
+#ifdef LATENCY_HISTOGRAMS
+void testLatencyHistograms(void) {
+
+    TEST_CASE("calls are recorded per thread") {
+        Allocator allocator;
+        uint8_t memory[256];
+        for (int index = 0; index < 256; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 256);
+        LatencyHistograms* latency = getThreadLatency();
+        uint64_t allocations = latency->allocate.count;
+        uint64_t deallocations = latency->deallocate.count;
+
+        void* block = allocate(&allocator, 16);
+        ASSERT_TRUE(allocate(&allocator, 4096) == NULL, "oversized allocation succeeded");
+        ASSERT_TRUE(deallocate(&allocator, block), "deallocation failed");
+        ASSERT_EQUAL_INT((int)(latency->allocate.count - allocations), 2, "allocations not recorded");
+        ASSERT_EQUAL_INT((int)(latency->deallocate.count - deallocations), 1, "deallocation not recorded");
+    } CASE_COMPLETE;
+
+    TEST_CASE("percentiles of known durations") {
+        LatencyHistogram histogram = {0};
+        for (uint64_t ticks = 1; ticks <= 1000; ticks++) recordLatency(&histogram, ticks);
+        LatencySummary summary = summarizeLatency(&histogram);
+
+        ASSERT_EQUAL_INT((int)summary.count, 1000, "wrong duration count");
+        ASSERT_EQUAL_INT((int)summary.sum, 500500, "wrong duration sum");
+        ASSERT_TRUE(summary.p50 >= 500 && summary.p50 < 500 * 5 / 4, "p50 outside its bucket bound [%d]", (int)summary.p50);
+        ASSERT_TRUE(summary.p99 >= 990 && summary.p99 < 990 * 5 / 4, "p99 outside its bucket bound [%d]", (int)summary.p99);
+        ASSERT_TRUE(summary.p999 >= 999 && summary.p999 < 999 * 5 / 4, "p999 outside its bucket bound [%d]", (int)summary.p999);
+        ASSERT_EQUAL_INT((int)latencyPercentile(&histogram, 1), 1, "shortest duration lost");
+        LatencyHistogram empty = {0};
+        ASSERT_EQUAL_INT((int)latencyPercentile(&empty, 500), 0, "empty histogram has a median");
+    } CASE_COMPLETE;
+
+    TEST_CASE("merging histograms") {
+        LatencyHistogram first = {0};
+        LatencyHistogram second = {0};
+        for (int i = 0; i < 99; i++) recordLatency(&first, 10);
+        recordLatency(&second, 1000000);
+        mergeLatency(&first, &second);
+
+        ASSERT_EQUAL_INT((int)first.count, 100, "merged count wrong");
+        ASSERT_EQUAL_INT((int)first.sum, 99 * 10 + 1000000, "merged sum wrong");
+        ASSERT_TRUE(latencyPercentile(&first, 500) < 16, "merge moved the median");
+        ASSERT_TRUE(latencyPercentile(&first, 999) >= 1000000, "merge lost the tail");
+    } CASE_COMPLETE;
+}
+#endif
+
+#ifdef SEARCH_COUNTERS
+void testGetSearchCounters(void) {
+
+    TEST_CASE("counters after initialization") {
+        Allocator allocator;
+        uint8_t memory[256];
+        for (int index = 0; index < 256; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 256);
+        SearchCounters counters = getSearchCounters(&allocator);
+
+        ASSERT_EQUAL_INT((int)counters.searches, 0, "searches counted before any allocation");
+        ASSERT_EQUAL_INT((int)counters.bits_examined, 0, "bits counted before any allocation");
+    } CASE_COMPLETE;
+
+    TEST_CASE("search through a fragmented map") {
+        Allocator allocator;
+        uint8_t memory[256];
+        for (int index = 0; index < 256; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 256);
+
+        // Leave a one-block hole before a used block
+        void* hole = allocate(&allocator, 16);
+        void* wall = allocate(&allocator, 16);
+        ASSERT_TRUE(deallocate(&allocator, hole), "deallocation failed");
+        SearchCounters before = getSearchCounters(&allocator);
+        void* block = allocate(&allocator, 32);
+        SearchCounters after = getSearchCounters(&allocator);
+
+        ASSERT_EQUAL_INT((int)(after.searches - before.searches), 1, "search not counted");
+        ASSERT_EQUAL_INT((int)(after.bits_examined - before.bits_examined), 4, "wrong number of bits examined");
+        ASSERT_EQUAL_INT((int)(after.words_visited - before.words_visited), 1, "wrong number of words visited");
+        ASSERT_EQUAL_INT((int)(after.restarts - before.restarts), 1, "abandoned match not counted");
+        ASSERT_EQUAL_INT((int)after.failed_searches, 0, "successful search counted as failed");
+
+        ASSERT_TRUE(allocate(&allocator, 4096) == NULL, "oversized allocation succeeded");
+        ASSERT_EQUAL_INT((int)getSearchCounters(&allocator).failed_searches, 1, "failed search not counted");
+        ASSERT_TRUE(deallocate(&allocator, block), "deallocation failed");
+        ASSERT_TRUE(deallocate(&allocator, wall), "deallocation failed");
+    } CASE_COMPLETE;
+}
+#endif
+
+#ifdef SIZE_ACCOUNTING
+void testGetSizeAccounting(void) {
+
+    TEST_CASE("requested and granted bytes") {
+        Allocator allocator;
+        uint8_t memory[1024];
+        for (int index = 0; index < 1024; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 1024);
+
+        void* first = allocate(&allocator, 18);
+        void* second = allocateZeroed(&allocator, 20);
+        void* third = allocate(&allocator, 64);
+        ASSERT_TRUE(first && second && third, "allocation failed");
+        ASSERT_TRUE(allocate(&allocator, 4096) == NULL, "oversized allocation succeeded");
+        ASSERT_TRUE(deallocate(&allocator, first), "deallocation failed");
+        const SizeAccounting* sizes = getSizeAccounting(&allocator);
+
+        ASSERT_EQUAL_INT((int)(sizes->total.allocations), 3, "failed allocation counted");
+        ASSERT_EQUAL_INT((int)(sizes->total.requested_bytes), 18 + 20 + 64, "wrong requested bytes");
+        ASSERT_EQUAL_INT((int)(sizes->total.granted_bytes), 32 + 32 + 64, "wrong granted bytes");
+        ASSERT_EQUAL_INT((int)(sizes->buckets[4].allocations), 2, "18 and 20 byte requests not bucketed together");
+        ASSERT_EQUAL_INT((int)(sizes->buckets[4].granted_bytes - sizes->buckets[4].requested_bytes), 26, "wrong bucket waste");
+        ASSERT_EQUAL_INT((int)(sizes->buckets[6].allocations), 1, "64 byte request not bucketed");
+        ASSERT_EQUAL_INT((int)(sizes->buckets[6].granted_bytes), (int)(sizes->buckets[6].requested_bytes), "exact request has waste");
+    } CASE_COMPLETE;
+
+    TEST_CASE("accounting reset by initialization") {
+        Allocator allocator;
+        uint8_t memory[256];
+        for (int index = 0; index < 256; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 256);
+        ASSERT_TRUE(allocate(&allocator, 1) != NULL, "allocation failed");
+        for (int index = 0; index < 256; index++) memory[index] = 0;
+        initAllocator(&allocator, 16, memory, 256);
+
+        ASSERT_EQUAL_INT((int)(getSizeAccounting(&allocator)->total.allocations), 0, "accounting survived initialization");
+        ASSERT_EQUAL_INT((int)(getSizeAccounting(&allocator)->buckets[0].allocations), 0, "bucket survived initialization");
+    } CASE_COMPLETE;
+}
+#endif
+
 int main(void) {
     LOG_INFO("ALLOCATOR TESTS\n");
     TEST_EVAL(testInitAllocator);
     TEST_EVAL(testAllocate);
     TEST_EVAL(testDeallocate);
+    TEST_EVAL(testDeallocateSized);
+    TEST_EVAL(testAllocateZeroed);
+    TEST_EVAL(testAllocateAligned);
+    TEST_EVAL(testAllocationSize);
+    TEST_EVAL(testGetAllocatorStats);
+    TEST_EVAL(testGetFragmentationStats);
+    TEST_EVAL(testDumpAllocator);
+    TEST_EVAL(testExportAllocatorStats);
+#ifdef ALLOCATION_TRACE
+    TEST_EVAL(testAllocationTrace);
+#endif
+#ifdef HEAP_PROFILE
+    TEST_EVAL(testHeapProfile);
+#endif
+#ifdef LATENCY_HISTOGRAMS
+    TEST_EVAL(testLatencyHistograms);
+#endif
+#ifdef SEARCH_COUNTERS
+    TEST_EVAL(testGetSearchCounters);
+#endif
+#ifdef SIZE_ACCOUNTING
+    TEST_EVAL(testGetSizeAccounting);
+#endif
     return testGetStatus();
 }
\ No newline at end of file